@@ -0,0 +1,537 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "map.h"
+#include "eurovision.h"
+#include "trace.h"
+
+#define DEFAULT_STATES 200
+#define DEFAULT_JUDGES 20
+#define DEFAULT_VOTES 1000000
+#define DEFAULT_QUERIES 50
+#define DEFAULT_SKEW 1.0
+#define JUDGE_RESULTS 10
+/* one vote in REMOVE_EVERY is removed instead of added */
+#define REMOVE_EVERY 4
+#define NAME_LENGTH 8
+#define LETTERS 26
+#define PERCENT 50
+#define LOOKUP_KINDS 3
+
+/**
+* The parameters of a synthetic workload and the random sequence it draws
+* from. Vote takers and judges results are drawn from a Zipf distribution over
+* the states, so a few states get most of the votes.
+*/
+typedef struct Workload_t {
+    int states;
+    int judges;
+    int votes;
+    int queries;
+    double skew;
+    double *zipf;
+    unsigned long long random;
+    long long *latencies;
+    const char *trace_path;
+} Workload;
+
+static MapKeyElement copyInt(MapKeyElement element)
+{
+    int *copy=malloc(sizeof(int));
+    if(copy==NULL)
+    {
+        return NULL;
+    }
+    *copy=*(int*)element;
+    return copy;
+}
+
+static void freeInt(MapKeyElement element)
+{
+    free(element);
+}
+
+static int compareInts(MapKeyElement first, MapKeyElement second)
+{
+    return *(int*)first-*(int*)second;
+}
+
+static long long now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC,&time);
+    return time.tv_sec*1000000000LL+time.tv_nsec;
+}
+
+static int compareLatencies(const void *first, const void *second)
+{
+    long long difference=*(const long long*)first-*(const long long*)second;
+    return (difference>0)-(difference<0);
+}
+
+/**
+* this function returns the next number of a xorshift* random sequence.
+*/
+static unsigned long long nextRandom(Workload *workload)
+{
+    unsigned long long x=workload->random;
+    x^=x>>12;
+    x^=x<<25;
+    x^=x>>27;
+    workload->random=x;
+    return x*2685821657736338717ULL;
+}
+
+static int nextUniform(Workload *workload, int range)
+{
+    return (int)(nextRandom(workload)%range);
+}
+
+/**
+* this function draws a state from the Zipf distribution of the workload, the
+* state with index i is drawn in proportion to 1/(i+1)^skew.
+*/
+static int nextZipf(Workload *workload)
+{
+    double point=(nextRandom(workload)>>11)*(1.0/9007199254740992.0);
+    int low=0, high=workload->states-1;
+    while(low<high)
+    {
+        int middle=low+(high-low)/2;
+        if(workload->zipf[middle]<point)
+        {
+            low=middle+1;
+        }
+        else
+        {
+            high=middle;
+        }
+    }
+    return low;
+}
+
+/**
+* this function fills the cumulative Zipf distribution of the workload.
+* @return
+* 	false if an allocation failed, true otherwise.
+*/
+static bool createZipf(Workload *workload)
+{
+    workload->zipf=malloc(sizeof(double)*workload->states);
+    if(workload->zipf==NULL)
+    {
+        return false;
+    }
+    double sum=0;
+    for(int i=0; i<workload->states; i++)
+    {
+        sum+=1/pow(i+1,workload->skew);
+        workload->zipf[i]=sum;
+    }
+    for(int i=0; i<workload->states; i++)
+    {
+        workload->zipf[i]/=sum;
+    }
+    return true;
+}
+
+/**
+* this function prints one line of JSON with the throughput and latency
+* percentiles of the timed operations and the peak resident set size of the
+* process so far.
+* @param name - name of the benchmark.
+* @param latencies - the latency of every operation in nanoseconds, sorted
+* by this function.
+* @param ops - number of operations.
+*/
+static void report(const char *name, long long *latencies, int ops)
+{
+    qsort(latencies,ops,sizeof(*latencies),compareLatencies);
+    long long total=0;
+    for(int i=0; i<ops; i++)
+    {
+        total+=latencies[i];
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    printf("{\"bench\":\"%s\",\"ops\":%d,\"ops_per_sec\":%.0f,"
+           "\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,"
+           "\"p999_ns\":%lld,\"max_ns\":%lld,\"peak_rss_kb\":%ld}\n",
+           name,ops,total ? ops*1e9/total : 0,latencies[ops/2],
+           latencies[(long)ops*90/100],latencies[(long)ops*99/100],
+           latencies[(long)ops*999/1000],latencies[ops-1],usage.ru_maxrss);
+    fflush(stdout);
+}
+
+/**
+* this function prints one line of JSON with the operation counters of a map
+* since the last report and zeroes them. the counters are kept only when the
+* map is compiled with -DMAP_STATS.
+* @param name - name of the benchmark the counters belong to.
+*/
+static void reportMapStats(const char *name, Map map)
+{
+    MapStats stats=mapGetStats(map);
+    mapResetStats(map);
+    if(stats.operations==0)
+    {
+        return;
+    }
+    printf("{\"bench\":\"%s\",\"operations\":%ld,"
+           "\"comparisons_per_op\":%.2f,\"nodes_per_op\":%.2f,"
+           "\"inserts\":%ld,\"removals\":%ld,\"key_copies\":%ld,"
+           "\"data_copies\":%ld}\n",name,stats.operations,
+           (double)stats.comparisons/stats.operations,
+           (double)stats.nodes_visited/stats.operations,stats.inserts,
+           stats.removals,stats.key_copies,stats.data_copies);
+}
+
+/**
+* this function prints one line of JSON with the counters of every phase of
+* the result functions that was timed. the phases are timed only when the
+* program is compiled with -DEUROVISION_TRACE.
+*/
+static void reportPhases()
+{
+    for(int phase=0; phase<TRACE_PHASES; phase++)
+    {
+        TraceCounters counters=traceGet(phase);
+        if(counters.calls==0)
+        {
+            continue;
+        }
+        printf("{\"phase\":\"%s\",\"calls\":%ld,\"total_ns\":%ld,"
+               "\"mean_ns\":%ld,\"max_ns\":%ld}\n",tracePhaseName(phase),
+               counters.calls,counters.total_ns,
+               counters.total_ns/counters.calls,counters.max_ns);
+    }
+}
+
+/**
+* this function writes the recorded phases of the result functions as a Chrome
+* trace to the trace path of the workload, if it has one.
+*/
+static bool writeTrace(Workload *workload)
+{
+    if(workload->trace_path==NULL)
+    {
+        return true;
+    }
+    FILE *file=fopen(workload->trace_path,"w");
+    if(file==NULL)
+    {
+        return false;
+    }
+    bool success=traceWriteChrome(file);
+    return fclose(file)==0 && success;
+}
+
+/**
+* this function times mapGet and mapRank of random keys and mapGetKth of random
+* indexes of a map holding the keys 0..votes-1.
+*/
+static void benchLookups(Workload *workload, Map map)
+{
+    const char *names[LOOKUP_KINDS]={"map_get","map_rank","map_get_kth"};
+    int size=workload->votes;
+    long long sum=0;
+    for(int kind=0; kind<LOOKUP_KINDS; kind++)
+    {
+        for(int i=0; i<size; i++)
+        {
+            int key=nextUniform(workload,size);
+            long long start=now();
+            if(kind==0)
+            {
+                sum+=*(int*)mapGet(map,&key);
+            }
+            else if(kind==1)
+            {
+                sum+=mapRank(map,&key);
+            }
+            else
+            {
+                sum+=*(int*)mapGetKth(map,key);
+            }
+            workload->latencies[i]=now()-start;
+        }
+        report(names[kind],workload->latencies,size);
+        reportMapStats(names[kind],map);
+    }
+    /* keeps the lookups from being optimized away */
+    if(sum<0)
+    {
+        printf("%lld\n",sum);
+    }
+}
+
+/**
+* this function times mapPutHint of the keys 0..votes-1 in increasing order.
+* @return
+* 	false if an allocation failed, true otherwise.
+*/
+static bool benchHinted(Workload *workload)
+{
+    Map map=mapCreate(copyInt,copyInt,freeInt,freeInt,compareInts);
+    if(map==NULL)
+    {
+        return false;
+    }
+    MapHint hint=MAP_HINT_INIT;
+    for(int i=0; i<workload->votes; i++)
+    {
+        long long start=now();
+        MapResult result=mapPutHint(map,&hint,&i,&i);
+        workload->latencies[i]=now()-start;
+        if(result!=MAP_SUCCESS)
+        {
+            mapDestroy(map);
+            return false;
+        }
+    }
+    report("map_put_hint_ascending",workload->latencies,workload->votes);
+    reportMapStats("map_put_hint_ascending",map);
+    mapDestroy(map);
+    return true;
+}
+
+/**
+* this function times mapPut of votes keys in a random order, the lookups of
+* benchLookups and mapRemove of all the keys in another random order.
+* @return
+* 	false if an allocation failed, true otherwise.
+*/
+static bool benchMap(Workload *workload)
+{
+    int size=workload->votes;
+    int *keys=malloc(sizeof(int)*size);
+    Map map=mapCreate(copyInt,copyInt,freeInt,freeInt,compareInts);
+    if(keys==NULL || map==NULL)
+    {
+        free(keys);
+        mapDestroy(map);
+        return false;
+    }
+    for(int i=0; i<size; i++)
+    {
+        keys[i]=i;
+    }
+    for(int round=0; round<2; round++)
+    {
+        for(int i=size-1; i>0; i--)
+        {
+            int j=nextUniform(workload,i+1), tmp=keys[i];
+            keys[i]=keys[j];
+            keys[j]=tmp;
+        }
+        for(int i=0; i<size; i++)
+        {
+            long long start=now();
+            MapResult result=round==0 ? mapPut(map,keys+i,keys+i) :
+                                        mapRemove(map,keys+i);
+            workload->latencies[i]=now()-start;
+            if(result!=MAP_SUCCESS)
+            {
+                free(keys);
+                mapDestroy(map);
+                return false;
+            }
+        }
+        if(round==0)
+        {
+            report("map_put",workload->latencies,size);
+            reportMapStats("map_put",map);
+            benchLookups(workload,map);
+        }
+    }
+    report("map_remove",workload->latencies,size);
+    reportMapStats("map_remove",map);
+    free(keys);
+    mapDestroy(map);
+    return true;
+}
+
+/**
+* this function writes a legal state name for a given index.
+*/
+static void stateName(int index, char name[NAME_LENGTH])
+{
+    int length=0;
+    do
+    {
+        name[length++]='a'+index%LETTERS;
+        index/=LETTERS;
+    } while(index && length<NAME_LENGTH-1);
+    name[length]='\0';
+}
+
+/**
+* this function creates a contest with the states and judges of the workload,
+* each judge ranks ten different states drawn from the Zipf distribution.
+* @return
+* 	the contest, or NULL if an allocation failed.
+*/
+static Eurovision createContest(Workload *workload)
+{
+    Eurovision eurovision=eurovisionCreate();
+    if(eurovision==NULL)
+    {
+        return NULL;
+    }
+    char name[NAME_LENGTH];
+    for(int i=0; i<workload->states; i++)
+    {
+        stateName(i,name);
+        if(eurovisionAddState(eurovision,i,name,name)!=EUROVISION_SUCCESS)
+        {
+            return NULL;
+        }
+    }
+    for(int i=0; i<workload->judges; i++)
+    {
+        int results[JUDGE_RESULTS];
+        for(int j=0; j<JUDGE_RESULTS; j++)
+        {
+            bool repeated=true;
+            while(repeated)
+            {
+                results[j]=nextZipf(workload);
+                repeated=false;
+                for(int k=0; k<j; k++)
+                {
+                    repeated=repeated || results[k]==results[j];
+                }
+            }
+        }
+        stateName(i,name);
+        if(eurovisionAddJudge(eurovision,i,name,results)!=EUROVISION_SUCCESS)
+        {
+            return NULL;
+        }
+    }
+    return eurovision;
+}
+
+/**
+* this function sends one vote from a random giver to a state drawn from the
+* Zipf distribution, every REMOVE_EVERY vote is a removal.
+* @param index - the index of the vote.
+*/
+static EurovisionResult sendVote(Workload *workload, Eurovision eurovision,
+                                 int index)
+{
+    int giver=nextUniform(workload,workload->states);
+    int taker=nextZipf(workload);
+    if(taker==giver)
+    {
+        taker=(taker+1)%workload->states;
+    }
+    return index%REMOVE_EVERY==0 ?
+           eurovisionRemoveVote(eurovision,giver,taker) :
+           eurovisionAddVote(eurovision,giver,taker);
+}
+
+/**
+* this function times eurovisionAddVote and eurovisionRemoveVote over the
+* votes of the workload, then each query function. Every query follows an
+* untimed vote, so the points are recounted by every contest query.
+* @return
+* 	false if an allocation failed, true otherwise.
+*/
+static bool benchContest(Workload *workload)
+{
+    Eurovision eurovision=createContest(workload);
+    if(eurovision==NULL)
+    {
+        return false;
+    }
+    for(int i=0; i<workload->votes; i++)
+    {
+        long long start=now();
+        EurovisionResult result=sendVote(workload,eurovision,i);
+        workload->latencies[i]=now()-start;
+        if(result!=EUROVISION_SUCCESS)
+        {
+            return false;
+        }
+    }
+    report("eurovision_vote",workload->latencies,workload->votes);
+    traceReset();
+    if(workload->trace_path!=NULL &&
+       !traceStartRecording((long)workload->queries*3*TRACE_PHASES))
+    {
+        return false;
+    }
+    const char *names[]={"eurovision_run_contest",
+                         "eurovision_run_audience_favorite",
+                         "eurovision_run_get_friendly_states"};
+    for(int query=0; query<(int)(sizeof(names)/sizeof(*names)); query++)
+    {
+        for(int i=0; i<workload->queries; i++)
+        {
+            if(sendVote(workload,eurovision,i+1)!=EUROVISION_SUCCESS)
+            {
+                return false;
+            }
+            long long start=now();
+            List result=query==0 ? eurovisionRunContest(eurovision,PERCENT) :
+                        query==1 ? eurovisionRunAudienceFavorite(eurovision) :
+                        eurovisionRunGetFriendlyStates(eurovision);
+            workload->latencies[i]=now()-start;
+            if(result==NULL)
+            {
+                return false;
+            }
+            listDestroy(result);
+        }
+        report(names[query],workload->latencies,workload->queries);
+    }
+    reportPhases();
+    eurovisionDestroy(eurovision);
+    return writeTrace(workload);
+}
+
+int main(int argc, char** argv)
+{
+    Workload workload;
+    workload.states=argc>1 ? atoi(argv[1]) : DEFAULT_STATES;
+    workload.judges=argc>2 ? atoi(argv[2]) : DEFAULT_JUDGES;
+    workload.votes=argc>3 ? atoi(argv[3]) : DEFAULT_VOTES;
+    workload.queries=argc>4 ? atoi(argv[4]) : DEFAULT_QUERIES;
+    workload.skew=argc>5 ? atof(argv[5]) : DEFAULT_SKEW;
+    workload.trace_path=argc>6 ? argv[6] : NULL;
+    workload.random=88172645463325252ULL;
+    if(workload.states<JUDGE_RESULTS || workload.judges<0 ||
+       workload.votes<1 || workload.queries<1 || workload.skew<0)
+    {
+        fprintf(stderr,"usage: %s [states] [judges] [votes] [queries] "
+                       "[skew] [trace file]\n",argv[0]);
+        return 1;
+    }
+    int ops=workload.votes>workload.queries ? workload.votes :
+                                                workload.queries;
+    workload.latencies=malloc(sizeof(long long)*ops);
+    if(workload.latencies==NULL || !createZipf(&workload))
+    {
+        free(workload.latencies);
+        fprintf(stderr,"out of memory\n");
+        return 1;
+    }
+    printf("{\"states\":%d,\"judges\":%d,\"votes\":%d,\"queries\":%d,"
+           "\"skew\":%.2f}\n",workload.states,workload.judges,workload.votes,
+           workload.queries,workload.skew);
+    bool success=benchMap(&workload) && benchHinted(&workload) &&
+                 benchContest(&workload);
+    free(workload.latencies);
+    free(workload.zipf);
+    if(!success)
+    {
+        fprintf(stderr,"benchmark failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -5,27 +5,161 @@
 #include "country.h"
 #include "judge.h"
 #include "eurovision.h"
+#include "ranking.h"
+#include "typed_map.h"
+#include "memstat.h"
+#include "trace.h"
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
 #define SIZE_OF_RANKING_ARRAY 10
 #define ADD_VOTE 1
 #define REMOVE_VOTE -1
-#define FIRST_SCORE 12
-#define SECOND_SCORE 10
-#define FIRST 0
-#define SECOND 1
 #define ILLEGAL -1
 #define TOP_TEN_COUNTRIES 10
-#define USED -1
 #define PERCENT 100
-#define EXTRA 4
+#define PAIR_SEPARATOR " - "
+#define PAIR_SEPARATOR_LENGTH (sizeof(PAIR_SEPARATOR) - 1)
+#define SWEEP_THREADS 8
+#define VOTE_STRIPES 64
+#define CACHE_LINE_SIZE 64
+#define VOTE_CHUNK_SIZE 512
+/* from this fraction of the countries on, a top k is taken from a full
+ * ranking, which a radix sort makes faster than the heap of rankingTopK */
+#define TOP_K_SORT_DIVISOR 8
+
+/**
+ * The audience and judges points of every country as computed at a given
+ * epoch, ordered by country id, and the contest ranking computed from them for
+ * one audience percent.
+ */
+typedef struct ContestCache_t {
+    bool valid;
+    unsigned long epoch;
+    int size;
+    int *ids;
+    int *audience_scores;
+    int *judges_scores;
+    int ranking_percent;
+    int *ranking;
+} ContestCache;
+
+/**
+ * A lock over the votes maps of the giver states whose id modulo VOTE_STRIPES
+ * is the index of the stripe, padded to a cache line so threads voting for
+ * different stripes do not share one.
+ */
+typedef struct VoteStripe_t {
+    pthread_mutex_t lock;
+    char padding[CACHE_LINE_SIZE - sizeof(pthread_mutex_t) % CACHE_LINE_SIZE];
+} VoteStripe;
+
+/**
+ * Votes buffered by one vote writer, chunks are pushed on a lock-free stack
+ * of the eurovision and merged into the votes maps together.
+ */
+typedef struct VoteChunk_t {
+    struct VoteChunk_t *next;
+    unsigned long removals;
+    int size;
+    VoteDelta votes[VOTE_CHUNK_SIZE];
+} VoteChunk;
+
+DEFINE_MAP(SlotMap, int, int)
+
+/**
+ * The dense slots of the states of the contest. Every state gets the lowest
+ * free slot when it is added and keeps it until it is removed, so arrays of
+ * per state data are indexed by slot. slots maps the ids in increasing order
+ * to their slots, ids maps the slots back and holds ILLEGAL for free slots.
+ * names holds the name of each state as kept by the country map, with its
+ * length in name_lengths, since the name of a state never changes.
+ * added_at holds the number of states removed from the contest when each
+ * state was added, so a state added again with the same id can be told apart.
+ */
+typedef struct StateDirectory_t {
+    SlotMap slots;
+    int *ids;
+    const char **names;
+    int *name_lengths;
+    unsigned long *added_at;
+    int *free_slots;
+    int free_num;
+    int used;
+    int capacity;
+} StateDirectory;
+
+/**
+ * The votes between the states as a table of counters changed with atomic
+ * operations, see eurovisionUseVoteTable. Row i holds the votes of the state
+ * in slot i, a row is marked dirty when it changes and is written back to the
+ * votes map of its state before the votes maps are read.
+ */
+typedef struct VoteTable_t {
+    int stride;
+    int *votes;
+    char *dirty;
+} VoteTable;
+
+/** A state receiving votes and the number of votes it receives */
+typedef struct TakerVotes_t {
+    int slot;
+    int id;
+    int votes;
+} TakerVotes;
+
+/** A state of a friendly pair and its name, for ranking the names */
+typedef struct NamedSlot_t {
+    int slot;
+    const char *name;
+} NamedSlot;
+
+/**
+ * Two friendly states by slot, the name of first comes first in their combined
+ * name. The pairs are ordered by lead_rank, the rank of the name of first
+ * followed by the separator, and then by tail_rank, the rank of the name of
+ * second, which orders them the same as their combined names.
+ */
+typedef struct FriendlyPair_t {
+    int first;
+    int second;
+    int lead_rank;
+    int tail_rank;
+} FriendlyPair;
 
 struct eurovision_t {
-    Map judge_map;
+    JudgeMap judge_map;
     Map country_map;
+    StateDirectory states;
+    unsigned long epoch;
+    ContestCache cache;
+    VoteStripe vote_stripes[VOTE_STRIPES];
+    VoteChunk *pending_votes;
+    unsigned long removals;
+    VoteTable *vote_table;
+};
+
+struct EurovisionVoteWriter_t {
+    Eurovision eurovision;
+    VoteChunk *chunk;
 };
 
+/**
+ * A range of audience percents ranked by one thread of
+ * eurovisionRunContestSweep, the rankings are written to the rows of the
+ * shared result array.
+ */
+typedef struct SweepTask_t {
+    const ContestCache *cache;
+    int judge_num;
+    const int *audience_percents;
+    int first;
+    int last;
+    int *rankings;
+    EurovisionResult result;
+} SweepTask;
+
 /**
  * This function creates a new string and copies the original string on it.
  *
@@ -35,7 +169,8 @@ struct eurovision_t {
  * new copy of the original string in case of success.
  */
 static ListElement copyString(ListElement str) {
-    char *copy_string = malloc(sizeof(char) * (strlen(str) + 1));
+    char *copy_string = memstatMalloc(MEMSTAT_EUROVISION,
+                                      sizeof(char) * (strlen(str) + 1));
     if (!copy_string) {
         return NULL;
     }
@@ -48,7 +183,7 @@ static ListElement copyString(ListElement str) {
  * @param str
  */
 static void freeString(ListElement str) {
-    free(str);
+    memstatFree(str);
 }
 
 /**
@@ -72,58 +207,550 @@ static bool legalString(const char *str) {
     return true;
 }
 
-/**this function gets the eurovision struct and two state IDs, and a integer
- * which decides if we are removing a vote or adding one, then checks some
- * conditions that the inputs must satisfy, and then updates the votes
- * accordingly.
+/**
+ * this function finds the slot of a state.
+ * @param directory
+ * @param id - the id of the state
+ * @return
+ * the slot of the state, or ILLEGAL if the state is not in the directory
+ */
+static int directorySlot(const StateDirectory *directory, int id) {
+    int *slot = SlotMapGet(directory->slots, id);
+    return slot ? *slot : ILLEGAL;
+}
+
+/**
+ * this function gives a new state the lowest free slot, the slots arrays are
+ * grown when all the slots are used.
+ * @param directory
+ * @param id - the id of the new state, not in the directory
+ * @param name - the name of the new state, kept until it is removed
+ * @param removals - the number of states removed from the contest so far
+ * @return
+ * the slot of the state, or ILLEGAL if an allocation failed
+ */
+static int directoryAdd(StateDirectory *directory, int id, const char *name,
+                        unsigned long removals) {
+    if (!directory->free_num && directory->used == directory->capacity) {
+        int capacity = directory->capacity ? directory->capacity * 2 :
+                       TYPED_MAP_FIRST_CAPACITY;
+        int *ids = memstatRealloc(MEMSTAT_EUROVISION,
+                                  directory->ids, sizeof(int) * capacity);
+        if (!ids) {
+            return ILLEGAL;
+        }
+        directory->ids = ids;
+        const char **names = memstatRealloc(MEMSTAT_EUROVISION,
+                                            directory->names,
+                                            sizeof(*names) * capacity);
+        if (!names) {
+            return ILLEGAL;
+        }
+        directory->names = names;
+        int *name_lengths = memstatRealloc(MEMSTAT_EUROVISION,
+                                           directory->name_lengths,
+                                           sizeof(int) * capacity);
+        if (!name_lengths) {
+            return ILLEGAL;
+        }
+        directory->name_lengths = name_lengths;
+        unsigned long *added_at = memstatRealloc(MEMSTAT_EUROVISION,
+                                                 directory->added_at,
+                                                 sizeof(*added_at) * capacity);
+        if (!added_at) {
+            return ILLEGAL;
+        }
+        directory->added_at = added_at;
+        int *free_slots = memstatRealloc(MEMSTAT_EUROVISION,
+                                         directory->free_slots,
+                                         sizeof(int) * capacity);
+        if (!free_slots) {
+            return ILLEGAL;
+        }
+        directory->free_slots = free_slots;
+        directory->capacity = capacity;
+    }
+    int slot = directory->free_num ?
+               directory->free_slots[directory->free_num - 1] :
+               directory->used;
+    if (SlotMapPut(directory->slots, id, slot) != MAP_SUCCESS) {
+        return ILLEGAL;
+    }
+    if (directory->free_num) {
+        directory->free_num--;
+    } else {
+        directory->used++;
+    }
+    directory->ids[slot] = id;
+    directory->names[slot] = name;
+    directory->name_lengths[slot] = (int) strlen(name);
+    directory->added_at[slot] = removals;
+    return slot;
+}
+
+/**
+ * this function frees the slot of a state, the slot is given to the next
+ * state added. The free slots are kept in decreasing order so the lowest one
+ * is reused first.
+ * @param directory
+ * @param id - the id of a state in the directory
+ */
+static void directoryRemove(StateDirectory *directory, int id) {
+    int slot = directorySlot(directory, id);
+    SlotMapRemove(directory->slots, id);
+    directory->ids[slot] = ILLEGAL;
+    directory->names[slot] = NULL;
+    int i = directory->free_num++;
+    while (i > 0 && directory->free_slots[i - 1] < slot) {
+        directory->free_slots[i] = directory->free_slots[i - 1];
+        i--;
+    }
+    directory->free_slots[i] = slot;
+}
+
+/**
+ * this function frees the arrays of the directory.
+ * @param directory
+ */
+static void directoryClear(StateDirectory *directory) {
+    SlotMapDestroy(directory->slots);
+    memstatFree(directory->ids);
+    memstatFree(directory->names);
+    memstatFree(directory->name_lengths);
+    memstatFree(directory->added_at);
+    memstatFree(directory->free_slots);
+    directory->slots = NULL;
+    directory->ids = NULL;
+    directory->names = NULL;
+    directory->name_lengths = NULL;
+    directory->added_at = NULL;
+    directory->free_slots = NULL;
+}
+
+/**
+ * this function checks that a vote from stateGiver to stateTaker is legal.
  *
  * @param eurovision - the eurivision struct we work with
  * @param stateGiver - the voting state
  * @param stateTaker - the state which the stategiver is voting for
- * @param vote - decides if we are adding a vote or removing one
  * @return :
  * EUROVISION_NULL_ARGUMENT if a NULL argument was received
  * EUROVISION_INVALID_ID if one or both of the IDs for the states is negative
  * EUROVISION_STATE_NOT_EXIST if one or both of the states aren't in the contest
  * EUROVISION_SAME_STATE if the state is voting for itslef
- * EUROVISION_OUT_OF_MEMORY in case a memory allocation failed
- * EUROVISION_SUCCESS in case of success
+ * EUROVISION_SUCCESS if the vote is legal
  */
-static EurovisionResult voteUpdate(Eurovision eurovision, int stateGiver,
-                                   int stateTaker, int vote) {
-    int *tmp = NULL;
+static EurovisionResult checkVote(Eurovision eurovision, int stateGiver,
+                                  int stateTaker) {
     if (!eurovision) {
         return EUROVISION_NULL_ARGUMENT;
     }
     if (stateGiver < 0 || stateTaker < 0) {
         return EUROVISION_INVALID_ID;
     }
-    if (!mapContains(eurovision->country_map, &stateGiver) ||
-        !mapContains(eurovision->country_map, &stateTaker)) {
+    if (!SlotMapContains(eurovision->states.slots, stateGiver) ||
+        !SlotMapContains(eurovision->states.slots, stateTaker)) {
         return EUROVISION_STATE_NOT_EXIST;
     }
     if (stateGiver == stateTaker) {
         return EUROVISION_SAME_STATE;
     }
+    return EUROVISION_SUCCESS;
+}
+
+/**
+ * this function adds votes to a counter of the vote table without taking a
+ * lock, a negative number of votes removes votes and the counter never drops
+ * below zero.
+ * @param table
+ * @param giver - the slot of the voting state
+ * @param taker - the slot of the state receiving the votes
+ * @param vote - the number of votes to add, negative to remove votes
+ */
+static void tableAdd(VoteTable *table, int giver, int taker, int vote) {
+    int *count = table->votes + (long) giver * table->stride + taker;
+    if (vote > 0) {
+        __atomic_fetch_add(count, vote, __ATOMIC_RELAXED);
+    } else {
+        int current = __atomic_load_n(count, __ATOMIC_RELAXED), next;
+        do {
+            next = current + vote < 0 ? 0 : current + vote;
+            if (next == current) {
+                return;
+            }
+        } while (!__atomic_compare_exchange_n(count, &current, next, true,
+                                              __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED));
+    }
+    if (!__atomic_load_n(table->dirty + giver, __ATOMIC_RELAXED)) {
+        __atomic_store_n(table->dirty + giver, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * this function checks a vote the same as checkVote and adds it to the vote
+ * table.
+ * @param eurovision - a eurovision with a vote table
+ * @param stateGiver - the voting state
+ * @param stateTaker - the state which the stategiver is voting for
+ * @param vote - the number of votes to add, negative to remove votes
+ * @return
+ * the same results as checkVote
+ */
+static EurovisionResult tableVote(Eurovision eurovision, int stateGiver,
+                                  int stateTaker, int vote) {
+    if (stateGiver < 0 || stateTaker < 0) {
+        return EUROVISION_INVALID_ID;
+    }
+    int giver = directorySlot(&eurovision->states, stateGiver);
+    int taker = directorySlot(&eurovision->states, stateTaker);
+    if (giver == ILLEGAL || taker == ILLEGAL) {
+        return EUROVISION_STATE_NOT_EXIST;
+    }
+    if (stateGiver == stateTaker) {
+        return EUROVISION_SAME_STATE;
+    }
+    tableAdd(eurovision->vote_table, giver, taker, vote);
+    return EUROVISION_SUCCESS;
+}
+
+/**
+ * this function frees the vote table.
+ * @param table
+ */
+static void voteTableDestroy(VoteTable *table) {
+    if (!table) {
+        return;
+    }
+    memstatFree(table->votes);
+    memstatFree(table->dirty);
+    memstatFree(table);
+}
+
+/**
+ * this function grows the vote table to cover all the slots of the directory.
+ * @param table
+ * @param stride - the new number of slots, not smaller than the current one
+ * @return
+ * false if an allocation failed, the table is not changed
+ * true otherwise
+ */
+static bool tableResize(VoteTable *table, int stride) {
+    int *votes = memstatCalloc(MEMSTAT_EUROVISION,
+                               (size_t) stride * stride + 1, sizeof(int));
+    char *dirty = memstatCalloc(MEMSTAT_EUROVISION, stride + 1, sizeof(char));
+    if (!votes || !dirty) {
+        memstatFree(votes);
+        memstatFree(dirty);
+        return false;
+    }
+    for (int i = 0; i < table->stride; i++) {
+        memcpy(votes + (long) i * stride,
+               table->votes + (long) i * table->stride,
+               sizeof(int) * table->stride);
+        dirty[i] = table->dirty[i];
+    }
+    memstatFree(table->votes);
+    memstatFree(table->dirty);
+    table->votes = votes;
+    table->dirty = dirty;
+    table->stride = stride;
+    return true;
+}
+
+/**
+ * this function drops the votes of a removed state from the vote table, so
+ * its slot starts with no votes when it is reused.
+ * @param table
+ * @param slot
+ */
+static void tableClearSlot(VoteTable *table, int slot) {
+    memset(table->votes + (long) slot * table->stride, 0,
+           sizeof(int) * table->stride);
+    for (int i = 0; i < table->stride; i++) {
+        table->votes[(long) i * table->stride + slot] = 0;
+    }
+    table->dirty[slot] = 0;
+}
+
+/**
+ * this function adds votes from one state of the contest to another under the
+ * lock stripe of the giver, or in the vote table if there is one, a negative
+ * number of votes removes votes and the votes never drop below zero.
+ *
+ * @param eurovision - the eurivision struct we work with
+ * @param stateGiver - the voting state
+ * @param stateTaker - the state which the stategiver is voting for
+ * @param vote - the number of votes to add, negative to remove votes
+ * @return :
+ * EUROVISION_NULL_ARGUMENT if the giver has no votes map
+ * EUROVISION_OUT_OF_MEMORY in case a memory allocation failed, the eurovision
+ * is not destroyed
+ * EUROVISION_SUCCESS in case of success
+ */
+static EurovisionResult applyVote(Eurovision eurovision, int stateGiver,
+                                  int stateTaker, int vote) {
+    if (eurovision->vote_table) {
+        return tableVote(eurovision, stateGiver, stateTaker, vote);
+    }
     Map votes_map = getVotesMap(eurovision->country_map, stateGiver);
     if (!votes_map) {
         return EUROVISION_NULL_ARGUMENT;
     }
-    if (mapContains(votes_map, &stateTaker)) {
-        tmp = (int *) mapGet(votes_map, &stateTaker);
+    pthread_mutex_t *lock =
+            &eurovision->vote_stripes[stateGiver % VOTE_STRIPES].lock;
+    pthread_mutex_lock(lock);
+    int *tmp = (int *) mapGet(votes_map, &stateTaker);
+    if (tmp) {
         *tmp += vote;
-        if (*tmp < 0) {
-            *tmp = 0;
-        } else if (*tmp == 0) {
+        if (*tmp <= 0) {
             mapRemove(votes_map, &stateTaker);
-            return EUROVISION_SUCCESS;
         }
-    } else if (vote == REMOVE_VOTE) {
+    } else if (vote < 0) {
+        pthread_mutex_unlock(lock);
         return EUROVISION_SUCCESS;
     } else if (mapPut(votes_map, &stateTaker, &vote) == MAP_OUT_OF_MEMORY) {
-        eurovisionDestroy(eurovision);
+        pthread_mutex_unlock(lock);
         return EUROVISION_OUT_OF_MEMORY;
     }
+    pthread_mutex_unlock(lock);
+    __atomic_add_fetch(&eurovision->epoch, 1, __ATOMIC_RELAXED);
+    return EUROVISION_SUCCESS;
+}
+
+/**this function gets the eurovision struct and two state IDs, and a integer
+ * which decides if we are removing a vote or adding one, then checks some
+ * conditions that the inputs must satisfy, and then updates the votes
+ * accordingly.
+ *
+ * @param eurovision - the eurivision struct we work with
+ * @param stateGiver - the voting state
+ * @param stateTaker - the state which the stategiver is voting for
+ * @param vote - decides if we are adding a vote or removing one
+ * @return :
+ * EUROVISION_NULL_ARGUMENT if a NULL argument was received
+ * EUROVISION_INVALID_ID if one or both of the IDs for the states is negative
+ * EUROVISION_STATE_NOT_EXIST if one or both of the states aren't in the contest
+ * EUROVISION_SAME_STATE if the state is voting for itslef
+ * EUROVISION_OUT_OF_MEMORY in case a memory allocation failed, the vote is
+ * lost but the eurovision is not destroyed, since other threads may be voting
+ * in it at the same time
+ * EUROVISION_SUCCESS in case of success
+ */
+static EurovisionResult voteUpdate(Eurovision eurovision, int stateGiver,
+                                   int stateTaker, int vote) {
+    if (eurovision && eurovision->vote_table) {
+        return tableVote(eurovision, stateGiver, stateTaker, vote);
+    }
+    EurovisionResult result = checkVote(eurovision, stateGiver, stateTaker);
+    if (result != EUROVISION_SUCCESS) {
+        return result;
+    }
+    return applyVote(eurovision, stateGiver, stateTaker, vote);
+}
+
+/**
+ * this function pushes a full or flushed chunk of buffered votes on the
+ * pending chunks stack of the eurovision, without taking a lock.
+ * @param eurovision
+ * @param chunk
+ */
+static void pushVoteChunk(Eurovision eurovision, VoteChunk *chunk) {
+    chunk->next = __atomic_load_n(&eurovision->pending_votes,
+                                  __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&eurovision->pending_votes,
+                                        &chunk->next, chunk, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * this function frees a linked list of vote chunks.
+ * @param chunk - the first chunk of the list
+ */
+static void freeVoteChunks(VoteChunk *chunk) {
+    while (chunk) {
+        VoteChunk *next = chunk->next;
+        memstatFree(chunk);
+        chunk = next;
+    }
+}
+
+/**
+ * this function checks that both states of a buffered vote are still in the
+ * contest, and were not removed and added again since the chunk was started.
+ * @param eurovision
+ * @param chunk
+ * @param delta - a vote of the chunk
+ * @return
+ * true if the vote can be applied, false otherwise
+ */
+static bool isBufferedVoteValid(Eurovision eurovision, const VoteChunk *chunk,
+                                const VoteDelta *delta) {
+    if (checkVote(eurovision, delta->giver, delta->taker) !=
+        EUROVISION_SUCCESS) {
+        return false;
+    }
+    const StateDirectory *states = &eurovision->states;
+    return states->added_at[directorySlot(states, delta->giver)] <=
+           chunk->removals &&
+           states->added_at[directorySlot(states, delta->taker)] <=
+           chunk->removals;
+}
+
+/**
+ * this function takes all the pending chunks of buffered votes and applies
+ * their votes in the order the chunks were pushed, votes of states which were
+ * removed since they were buffered are dropped, even if a state with the same
+ * id was added since. The votes were checked when they were buffered, so they
+ * are only checked again if a state was removed since the chunk was started.
+ * @param eurovision
+ * @return
+ * EUROVISION_OUT_OF_MEMORY if an allocation failed, the eurovision is not
+ * destroyed and the votes which were not applied yet are lost
+ * EUROVISION_SUCCESS otherwise
+ */
+static EurovisionResult mergeVotes(Eurovision eurovision) {
+    if (!__atomic_load_n(&eurovision->pending_votes, __ATOMIC_RELAXED)) {
+        return EUROVISION_SUCCESS;
+    }
+    VoteChunk *stack = __atomic_exchange_n(&eurovision->pending_votes, NULL,
+                                           __ATOMIC_ACQUIRE);
+    VoteChunk *chunks = NULL;
+    while (stack) {
+        VoteChunk *next = stack->next;
+        stack->next = chunks;
+        chunks = stack;
+        stack = next;
+    }
+    for (VoteChunk *chunk = chunks; chunk; chunk = chunk->next) {
+        for (int i = 0; i < chunk->size; i++) {
+            VoteDelta *delta = chunk->votes + i;
+            if (chunk->removals != eurovision->removals &&
+                !isBufferedVoteValid(eurovision, chunk, delta)) {
+                continue;
+            }
+            if (applyVote(eurovision, delta->giver, delta->taker,
+                          delta->votes) == EUROVISION_OUT_OF_MEMORY) {
+                freeVoteChunks(chunks);
+                return EUROVISION_OUT_OF_MEMORY;
+            }
+        }
+    }
+    freeVoteChunks(chunks);
+    return EUROVISION_SUCCESS;
+}
+
+/**
+ * this function writes the dirty rows of the vote table back to the votes
+ * maps of their states.
+ * @param eurovision
+ * @return
+ * EUROVISION_OUT_OF_MEMORY if an allocation failed, the eurovision is not
+ * destroyed
+ * EUROVISION_SUCCESS otherwise
+ */
+static EurovisionResult syncVoteTable(Eurovision eurovision) {
+    VoteTable *table = eurovision->vote_table;
+    if (!table) {
+        return EUROVISION_SUCCESS;
+    }
+    int *ids = eurovision->states.ids;
+    for (int i = 0; i < eurovision->states.used; i++) {
+        if (!table->dirty[i]) {
+            continue;
+        }
+        table->dirty[i] = 0;
+        eurovision->epoch++;
+        Map votes_map = getVotesMap(eurovision->country_map, ids[i]);
+        int *row = table->votes + (long) i * table->stride;
+        for (int j = 0; j < eurovision->states.used; j++) {
+            if (ids[j] == ILLEGAL) {
+                continue;
+            }
+            int *votes = mapGet(votes_map, ids + j);
+            if (votes && row[j]) {
+                *votes = row[j];
+            } else if (votes) {
+                mapRemove(votes_map, ids + j);
+            } else if (row[j] && mapPut(votes_map, ids + j, row + j) ==
+                                 MAP_OUT_OF_MEMORY) {
+                table->dirty[i] = 1;
+                return EUROVISION_OUT_OF_MEMORY;
+            }
+        }
+    }
+    return EUROVISION_SUCCESS;
+}
+
+/**
+ * this function merges the pending buffered votes and writes the vote table
+ * back, so the votes maps of the states hold all the votes.
+ * @param eurovision
+ * @return
+ * EUROVISION_OUT_OF_MEMORY if an allocation failed, the eurovision is not
+ * destroyed
+ * EUROVISION_SUCCESS otherwise
+ */
+static EurovisionResult syncVotes(Eurovision eurovision) {
+    TRACE_BEGIN(span);
+    EurovisionResult result = mergeVotes(eurovision);
+    if (result == EUROVISION_SUCCESS) {
+        result = syncVoteTable(eurovision);
+    }
+    TRACE_END(span, TRACE_SYNC_VOTES);
+    return result;
+}
+
+/**
+ * this function buffers a vote of a vote writer, a vote for the same two
+ * states in the same direction as the last buffered vote is added to it. A
+ * full chunk is pushed for merging.
+ * @param writer
+ * @param stateGiver
+ * @param stateTaker
+ * @param vote - ADD_VOTE or REMOVE_VOTE
+ * @return
+ * the same results as voteUpdate, on EUROVISION_OUT_OF_MEMORY the vote is not
+ * buffered and the eurovision is not destroyed
+ */
+static EurovisionResult bufferVote(EurovisionVoteWriter writer,
+                                   int stateGiver, int stateTaker, int vote) {
+    if (!writer) {
+        return EUROVISION_NULL_ARGUMENT;
+    }
+    EurovisionResult result = checkVote(writer->eurovision, stateGiver,
+                                        stateTaker);
+    if (result != EUROVISION_SUCCESS) {
+        return result;
+    }
+    VoteChunk *chunk = writer->chunk;
+    if (!chunk) {
+        chunk = memstatMalloc(MEMSTAT_EUROVISION, sizeof(*chunk));
+        if (!chunk) {
+            return EUROVISION_OUT_OF_MEMORY;
+        }
+        chunk->size = 0;
+        chunk->removals = writer->eurovision->removals;
+        writer->chunk = chunk;
+    }
+    if (chunk->size) {
+        VoteDelta *last = chunk->votes + chunk->size - 1;
+        /* removals in a row clamp at zero the same as one larger removal */
+        if (last->giver == stateGiver && last->taker == stateTaker &&
+            (last->votes < 0) == (vote < 0)) {
+            last->votes += vote;
+            return EUROVISION_SUCCESS;
+        }
+    }
+    chunk->votes[chunk->size].giver = stateGiver;
+    chunk->votes[chunk->size].taker = stateTaker;
+    chunk->votes[chunk->size].votes = vote;
+    chunk->size++;
+    if (chunk->size == VOTE_CHUNK_SIZE) {
+        pushVoteChunk(writer->eurovision, chunk);
+        writer->chunk = NULL;
+    }
     return EUROVISION_SUCCESS;
 }
 
@@ -146,225 +773,442 @@ static bool doubleJudgeVote(int *judgeResults) {
 }
 
 /**
- * this function gets a map of the votes of a specific country and finds the
- * country which gets the most votes.
- *
- * @param votes_map map which includes the countries and the votes of a
- * specific country to those countries
- * @return
- * country ID of the country with the maximum votes
- * ILLEGAL if the map is NULL or the map is empty
+ * this function finds the favorite of every state, the state it gave the most
+ * votes to, the one with the smallest id if a few states got the most votes.
+ * @param eurovision
+ * @param favorites - receives the slot of the favorite of each slot, ILLEGAL
+ * for free slots and states which gave no votes
  */
-static int findMax(Map votes_map) {
-    if (!votes_map) {
-        return ILLEGAL;
-    }
-    if (!mapGetSize(votes_map)) {
-        return ILLEGAL;
-    }
-    int *max_country_id = mapGetFirst(votes_map);
-    int *country_id = mapGetNext(votes_map);
-    int country_votes, max_country_votes;
-    while (country_id) {
-        max_country_votes = *(int *) mapGet(votes_map, max_country_id);
-        country_votes = *(int *) mapGet(votes_map, country_id);
-        if (country_votes > max_country_votes) {
-            max_country_id = country_id;
+static void fillFavorites(Eurovision eurovision, int *favorites) {
+    StateDirectory *states = &eurovision->states;
+    VoteTable *table = eurovision->vote_table;
+    for (int giver = 0; giver < states->used; giver++) {
+        favorites[giver] = ILLEGAL;
+        if (states->ids[giver] == ILLEGAL) {
+            continue;
+        }
+        int max_votes = 0;
+        if (table) {
+            int *row = table->votes + (long) giver * table->stride;
+            for (int taker = 0; taker < states->used; taker++) {
+                if (row[taker] > max_votes ||
+                    (row[taker] == max_votes && max_votes &&
+                     states->ids[taker] < states->ids[favorites[giver]])) {
+                    max_votes = row[taker];
+                    favorites[giver] = taker;
+                }
+            }
+            continue;
+        }
+        Map votes_map = getVotesMap(eurovision->country_map,
+                                    states->ids[giver]);
+        MAP_FOREACH(int *, taker_id, votes_map) {
+            int votes = *(int *) mapGet(votes_map, taker_id);
+            if (votes > max_votes) {
+                max_votes = votes;
+                favorites[giver] = directorySlot(states, *taker_id);
+            }
         }
-        country_id = mapGetNext(votes_map);
     }
-    return *max_country_id;
 }
 
 /**
- * this function counts the points each country gets from the audience and adds
- * the points to the audience score in the country struct, first the function
- * clears the scores for the new count, then for each country finds the top ten
- * and give them points accordingly.
- * @param eurovision
+ * this function adds a taker to the top ten takers of a giver, which are kept
+ * ordered by their votes from the most and by their ids on equal votes.
+ * @param top - the top ten array
+ * @param top_num - the number of takers in the array
+ * @param slot - the slot of the taker
+ * @param id - the id of the taker
+ * @param votes - the votes of the taker
  * @return
- * EUROVISION_OUT_OF_MEMORY if an allocation failed
- * EUROVISION_SUCCESS if the scores were calculated successfully
+ * the new number of takers in the array
  */
-static EurovisionResult fillAudienceScore(Eurovision eurovision) {
-    int *giver_country = mapGetFirst(eurovision->country_map);
-    while (giver_country) {
-        putAudienceScore(eurovision->country_map, *giver_country, 0);
-        giver_country = mapGetNext(eurovision->country_map);
+static int insertTopTen(TakerVotes *top, int top_num, int slot, int id,
+                        int votes) {
+    if (top_num == TOP_TEN_COUNTRIES) {
+        TakerVotes *last = top + top_num - 1;
+        if (votes < last->votes || (votes == last->votes && id > last->id)) {
+            return top_num;
+        }
+        top_num--;
     }
-    giver_country = mapGetFirst(eurovision->country_map);
-    Map votes_map;
-    int taker_country, updated_points;
-    while (giver_country) {
-        votes_map = getVotesMap(eurovision->country_map, *giver_country);
-        Map votes_map_copy = mapCopy(votes_map);
-        int votes_map_size = mapGetSize(votes_map);
-        if (!votes_map) {
-            return EUROVISION_OUT_OF_MEMORY;
+    int i = top_num;
+    while (i > 0 && (votes > top[i - 1].votes ||
+                     (votes == top[i - 1].votes && id < top[i - 1].id))) {
+        top[i] = top[i - 1];
+        i--;
+    }
+    top[i].slot = slot;
+    top[i].id = id;
+    top[i].votes = votes;
+    return top_num + 1;
+}
+
+/**
+ * this function counts the points each country gets from the audience, for
+ * each country it finds the top ten countries it voted for in one pass over
+ * its votes, the row of the vote table if there is one, and gives them points
+ * accordingly.
+ * @param eurovision
+ * @param points - receives the points of each slot, zeroed by the caller
+ */
+static void fillAudienceScore(Eurovision eurovision, int *points) {
+    StateDirectory *states = &eurovision->states;
+    VoteTable *table = eurovision->vote_table;
+    TakerVotes top[TOP_TEN_COUNTRIES];
+    for (int giver = 0; giver < states->used; giver++) {
+        if (states->ids[giver] == ILLEGAL) {
+            continue;
         }
-        for (int i = 0; i < TOP_TEN_COUNTRIES; i++) {
-            if (!votes_map_size) {
-                break;
+        int top_num = 0;
+        if (table) {
+            int *row = table->votes + (long) giver * table->stride;
+            for (int taker = 0; taker < states->used; taker++) {
+                if (row[taker]) {
+                    top_num = insertTopTen(top, top_num, taker,
+                                           states->ids[taker], row[taker]);
+                }
             }
-            votes_map_size--;
-            taker_country = findMax(votes_map_copy);
-            mapRemove(votes_map_copy, &taker_country);
-            updated_points = getAudienceScore(eurovision->country_map,
-                                              taker_country);
-            if (i == FIRST) {
-                updated_points += FIRST_SCORE;
-            } else if (i == SECOND) {
-                updated_points += SECOND_SCORE;
-            } else {
-                updated_points += (TOP_TEN_COUNTRIES - i);
+        } else {
+            Map votes_map = getVotesMap(eurovision->country_map,
+                                        states->ids[giver]);
+            MAP_FOREACH(int *, taker_id, votes_map) {
+                top_num = insertTopTen(top, top_num,
+                                       directorySlot(states, *taker_id),
+                                       *taker_id,
+                                       *(int *) mapGet(votes_map, taker_id));
             }
-            putAudienceScore(eurovision->country_map, taker_country,
-                             updated_points);
         }
-        mapDestroy(votes_map_copy);
-        giver_country = mapGetNext(eurovision->country_map);
+        for (int i = 0; i < top_num; i++) {
+            points[top[i].slot] += rankingPlacePoints(i);
+        }
     }
-    return EUROVISION_SUCCESS;
 }
 
 /**
- * this function counts the points each country gets from the judges and adds
- * the points to the judges score in the country struct, first the function
- * clears the scores for the new count, then for each judge finds the top ten
- * and give them points accordingly.
+ * this function counts the points each country gets from the judges, each
+ * judge gives points to the ten countries of its results.
  * @param eurovision
+ * @param points - receives the points of each slot, zeroed by the caller
  */
-static void fillJudgeScore(Eurovision eurovision) {
-    int *giver_country = mapGetFirst(eurovision->country_map);
-    while (giver_country) {
-        putJudgesScore(eurovision->country_map, *giver_country, 0);
-        giver_country = mapGetNext(eurovision->country_map);
-    }
-    int *giver_judge = mapGetFirst(eurovision->judge_map);
+static void fillJudgeScore(Eurovision eurovision, int *points) {
     int *votes_array;
-    int taker_country, updated_points;
-    while (giver_judge) {
-        votes_array = getJudgeResults(eurovision->judge_map, *giver_judge);
+    for (int j = 0; j < judgeMapGetSize(eurovision->judge_map); j++) {
+        votes_array = getJudgeResults(eurovision->judge_map,
+                                      judgeMapGetId(eurovision->judge_map, j));
         for (int i = 0; i < SIZE_OF_RANKING_ARRAY; i++) {
-            taker_country = *(votes_array + i);
-            updated_points = getJudgesScore(eurovision->country_map,
-                                            taker_country);
-            if (i == FIRST) {
-                updated_points += FIRST_SCORE;
-            } else if (i == SECOND) {
-                updated_points += SECOND_SCORE;
-            } else {
-                updated_points += TOP_TEN_COUNTRIES - i;
-            }
-            putJudgesScore(eurovision->country_map, taker_country,
-                           updated_points);
+            points[directorySlot(&eurovision->states, votes_array[i])] +=
+                    rankingPlacePoints(i);
         }
-        giver_judge = mapGetNext(eurovision->judge_map);
     }
 }
 
 /**
- * this function gets two country names and merge them in lexicographical order
- * into a new string : "name1 - name2"
- * @param first_country - name of the first country
- * @param second_country - name of the second coountry
+ * this function frees the arrays held by the contest cache and marks it as
+ * invalid.
+ * @param cache
+ */
+static void cacheClear(ContestCache *cache) {
+    memstatFree(cache->ids);
+    memstatFree(cache->audience_scores);
+    memstatFree(cache->judges_scores);
+    memstatFree(cache->ranking);
+    cache->ids = NULL;
+    cache->audience_scores = NULL;
+    cache->judges_scores = NULL;
+    cache->ranking = NULL;
+    cache->size = 0;
+    cache->ranking_percent = 0;
+    cache->valid = false;
+}
+
+/**
+ * this function syncs the buffered and table votes and makes sure the contest
+ * cache holds the audience and judges points of the current epoch, the points
+ * are only recounted if a mutating function was called since they were last
+ * counted.
+ * @param eurovision
  * @return
- * NULL if a memory allocation failed
- * string if the two names were merged successfully
- */
-static char *combineNames(char *first_country, char *second_country) {
-    char *tmp1 = first_country;
-    char *tmp2 = second_country;
-    char *space = " - ";
-    char *friendly_countries = malloc(strlen(first_country)
-                                      + strlen(second_country) + EXTRA);
-    if (!friendly_countries) {
-        return NULL;
+ * EUROVISION_OUT_OF_MEMORY if an allocation failed
+ * EUROVISION_SUCCESS if the cache is up to date
+ */
+static EurovisionResult fillTallies(Eurovision eurovision) {
+    if (syncVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    ContestCache *cache = &eurovision->cache;
+    if (cache->valid && cache->epoch == eurovision->epoch) {
+        return EUROVISION_SUCCESS;
+    }
+    cacheClear(cache);
+    StateDirectory *states = &eurovision->states;
+    int size = SlotMapGetSize(states->slots);
+    int *points = memstatCalloc(MEMSTAT_EUROVISION,
+                                2 * states->used + 1, sizeof(int));
+    if (!points) {
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    int *audience_points = points, *judges_points = points + states->used;
+    TRACE_BEGIN(audience_span);
+    fillAudienceScore(eurovision, audience_points);
+    TRACE_END(audience_span, TRACE_AUDIENCE_SCORE);
+    TRACE_BEGIN(judges_span);
+    fillJudgeScore(eurovision, judges_points);
+    TRACE_END(judges_span, TRACE_JUDGE_SCORE);
+    if (size) {
+        cache->ids = memstatMalloc(MEMSTAT_EUROVISION, sizeof(int) * size);
+        cache->audience_scores = memstatMalloc(MEMSTAT_EUROVISION,
+                                               sizeof(int) * size);
+        cache->judges_scores = memstatMalloc(MEMSTAT_EUROVISION,
+                                             sizeof(int) * size);
+        cache->ranking = memstatMalloc(MEMSTAT_EUROVISION, sizeof(int) * size);
+        if (!cache->ids || !cache->audience_scores || !cache->judges_scores ||
+            !cache->ranking) {
+            memstatFree(points);
+            cacheClear(cache);
+            return EUROVISION_OUT_OF_MEMORY;
+        }
+    }
+    for (int i = 0; i < size; i++) {
+        int slot = *SlotMapValueAt(states->slots, i);
+        cache->ids[i] = SlotMapKeyAt(states->slots, i);
+        cache->audience_scores[i] = audience_points[slot];
+        cache->judges_scores[i] = judges_points[slot];
     }
+    memstatFree(points);
+    cache->size = size;
+    cache->epoch = eurovision->epoch;
+    cache->valid = true;
+    return EUROVISION_SUCCESS;
+}
 
-    while (*tmp1 && *tmp2 && *tmp1 == *tmp2) {
-        tmp1++;
-        tmp2++;
+/**
+ * this function ranks all the countries of the contest cache for the given
+ * audience percent.
+ * @param cache - a valid contest cache holding at least one country
+ * @param judge_num - the number of judges
+ * @param audiencePercent
+ * @param scored - room for twice the number of countries of the cache
+ * @param ranking - receives the ids of the countries from the best ranked
+ */
+static void rankTallies(const ContestCache *cache, int judge_num,
+                        int audiencePercent, ScoredCountry *scored,
+                        int *ranking) {
+    for (int i = 0; i < cache->size; i++) {
+        scored[i].id = cache->ids[i];
+        scored[i].score = rankingContestScore(cache->audience_scores[i],
+                                              cache->judges_scores[i],
+                                              audiencePercent, cache->size - 1,
+                                              judge_num);
     }
+    rankingRadixSort(scored, cache->size, scored + cache->size);
+    for (int i = 0; i < cache->size; i++) {
+        ranking[i] = scored[i].id;
+    }
+}
 
-    if (*tmp1 - *tmp2 > 0) {
-        strcpy(friendly_countries, second_country);
-        strcat(friendly_countries, space);
-        strcat(friendly_countries, first_country);
-    } else {
-        strcpy(friendly_countries, first_country);
-        strcat(friendly_countries, space);
-        strcat(friendly_countries, second_country);
+/**
+ * this function ranks all the countries of the contest cache for the given
+ * audience percent and stores the ranking in the cache, unless the cache
+ * already holds the ranking for this percent.
+ * @param eurovision
+ * @param audiencePercent
+ * @return
+ * EUROVISION_OUT_OF_MEMORY if an allocation failed
+ * EUROVISION_SUCCESS if the ranking is stored in the cache
+ */
+static EurovisionResult fillRanking(Eurovision eurovision,
+                                    int audiencePercent) {
+    ContestCache *cache = &eurovision->cache;
+    if (cache->ranking_percent == audiencePercent || !cache->size) {
+        return EUROVISION_SUCCESS;
     }
-    return friendly_countries;
+    ScoredCountry *scored = memstatMalloc(MEMSTAT_EUROVISION,
+                                          sizeof(*scored) * 2 * cache->size);
+    if (!scored) {
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    TRACE_BEGIN(span);
+    rankTallies(cache, judgeMapGetSize(eurovision->judge_map),
+                audiencePercent, scored, cache->ranking);
+    TRACE_END(span, TRACE_RANKING);
+    memstatFree(scored);
+    cache->ranking_percent = audiencePercent;
+    return EUROVISION_SUCCESS;
 }
 
 /**
- * this function is used as a sorting function for the listSort.
- * @param str1
- * @param str2
+ * this function is run by the threads of eurovisionRunContestSweep, it ranks
+ * the countries for each audience percent of its task.
+ * @param task
  * @return
- * positive if str1 > str2
- * zero if str1 = str2
- * negative if str1 < str2
+ * the given task, its result is EUROVISION_OUT_OF_MEMORY if an allocation
+ * failed and EUROVISION_SUCCESS otherwise
  */
-static int stringSort(ListElement str1, ListElement str2) {
-    return strcmp(str1, str2);
+static void *runSweepTask(void *task) {
+    SweepTask *sweep_task = task;
+    int size = sweep_task->cache->size;
+    ScoredCountry *scored = memstatMalloc(MEMSTAT_EUROVISION,
+                                          sizeof(*scored) * 2 * size);
+    if (!scored) {
+        sweep_task->result = EUROVISION_OUT_OF_MEMORY;
+        return task;
+    }
+    TRACE_BEGIN(span);
+    for (int i = sweep_task->first; i < sweep_task->last; i++) {
+        rankTallies(sweep_task->cache, sweep_task->judge_num,
+                    sweep_task->audience_percents[i], scored,
+                    sweep_task->rankings + (long) i * size);
+    }
+    TRACE_END(span, TRACE_RANKING);
+    memstatFree(scored);
+    sweep_task->result = EUROVISION_SUCCESS;
+    return task;
 }
 
 /**
- * this function finds the matching id which the function receives and remove it
- * from the given list
- * @param list
- * @param id
+ * this function writes the labels of friendly pairs, "first - second", one
+ * after the other into one block given to the list, and inserts them at the
+ * end of the list.
+ * @param states
+ * @param pairs
+ * @param pairs_num
+ * @param list - a borrowing list with room for all the labels
+ * @return
+ * false if an allocation failed, the list is left unchanged
+ * true otherwise
  */
-static void removeElementFromList(List list, int *id) {
-    int *ptr = listGetFirst(list);
-    while (ptr) {
-        if (*ptr == *id) {
-            listRemoveCurrent(list);
-            return;
-        }
-        ptr = listGetNext(list);
+static bool insertPairLabels(const StateDirectory *states,
+                             const FriendlyPair *pairs, int pairs_num,
+                             List list) {
+    size_t size = 0;
+    for (int i = 0; i < pairs_num; i++) {
+        size += states->name_lengths[pairs[i].first] + PAIR_SEPARATOR_LENGTH +
+                states->name_lengths[pairs[i].second] + 1;
+    }
+    char *arena = memstatMalloc(MEMSTAT_EUROVISION, size ? size : 1);
+    if (!arena) {
+        return false;
     }
+    listSetStorage(list, arena, size, freeString);
+    char *out = arena;
+    for (int i = 0; i < pairs_num; i++) {
+        int first = pairs[i].first, second = pairs[i].second;
+        char *label = out;
+        memcpy(out, states->names[first], states->name_lengths[first]);
+        out += states->name_lengths[first];
+        memcpy(out, PAIR_SEPARATOR, PAIR_SEPARATOR_LENGTH);
+        out += PAIR_SEPARATOR_LENGTH;
+        memcpy(out, states->names[second], states->name_lengths[second]);
+        out += states->name_lengths[second];
+        *(out++) = '\0';
+        listInsertLast(list, label);
+    }
+    return true;
 }
 
 /**
- * this function allocates memory for an integer and copies the given value in
- * it.
- * @param key
+ * this function compares the names of two named slots, for qsort.
+ * @param first
+ * @param second
  * @return
- * NULL if a NULL argument was received or a memory allocation failed
- * a pointer for the new integer with the same value in case of success
+ * positive if the first name is larger, zero if they are equal and negative
+ * otherwise
  */
-static ListElement copyInt(ListElement key) {
-    if (!key) {
-        return NULL;
+static int compareNames(const void *first, const void *second) {
+    return strcmp(((const NamedSlot *) first)->name,
+                  ((const NamedSlot *) second)->name);
+}
+
+/**
+ * this function compares the names of two named slots as if each one was
+ * followed by PAIR_SEPARATOR, the way they lead a combined name, for qsort.
+ * @param first
+ * @param second
+ * @return
+ * positive if the first name is larger, zero if they are equal and negative
+ * otherwise
+ */
+static int compareLeadNames(const void *first, const void *second) {
+    const char *name1 = ((const NamedSlot *) first)->name;
+    const char *name2 = ((const NamedSlot *) second)->name;
+    const char *separator1 = PAIR_SEPARATOR, *separator2 = PAIR_SEPARATOR;
+    while (true) {
+        unsigned char char1 = *name1 ? *name1++ : *separator1++;
+        unsigned char char2 = *name2 ? *name2++ : *separator2++;
+        if (char1 != char2 || !char1) {
+            return char1 - char2;
+        }
     }
-    int *copy = malloc(sizeof(*copy));
-    if (!copy) {
-        return NULL;
+}
+
+/**
+ * this function sorts named slots and ranks their names, equal names get the
+ * same rank.
+ * @param members
+ * @param members_num
+ * @param compare - compareNames or compareLeadNames
+ * @param ranks - receives the rank of each slot of members
+ */
+static void rankNames(NamedSlot *members, int members_num,
+                      int (*compare)(const void *, const void *),
+                      int *ranks) {
+    qsort(members, members_num, sizeof(*members), compare);
+    for (int i = 0; i < members_num; i++) {
+        ranks[members[i].slot] = i > 0 && !compare(members + i - 1,
+                                                   members + i) ?
+                                 ranks[members[i - 1].slot] : i;
     }
-    *copy = *(int *) key;
-    return copy;
 }
 
 /**
- * this function frees the memory allocated for the given integer key
- * @param key
+ * this function compares two friendly pairs by the order of their combined
+ * names, for qsort.
+ * @param first
+ * @param second
+ * @return
+ * positive if the first pair comes later, zero if the pairs have the same
+ * combined name and negative otherwise
  */
-static void freeInt(ListElement key) {
-    free(key);
+static int comparePairs(const void *first, const void *second) {
+    const FriendlyPair *pair1 = first, *pair2 = second;
+    if (pair1->lead_rank != pair2->lead_rank) {
+        return pair1->lead_rank - pair2->lead_rank;
+    }
+    return pair1->tail_rank - pair2->tail_rank;
 }
 
 Eurovision eurovisionCreate() {
-    Eurovision eurovision = malloc(sizeof(*eurovision));
+    Eurovision eurovision = memstatMalloc(MEMSTAT_EUROVISION,
+                                          sizeof(*eurovision));
     if (!eurovision) {
         return NULL;
     }
+    for (int i = 0; i < VOTE_STRIPES; i++) {
+        pthread_mutex_init(&eurovision->vote_stripes[i].lock, NULL);
+    }
     eurovision->judge_map = judgeMapCreate();
     eurovision->country_map = countryMapCreate();
-    if (!eurovision->country_map || !eurovision->judge_map) {
+    eurovision->states.slots = SlotMapCreate();
+    eurovision->states.ids = NULL;
+    eurovision->states.names = NULL;
+    eurovision->states.name_lengths = NULL;
+    eurovision->states.added_at = NULL;
+    eurovision->states.free_slots = NULL;
+    eurovision->states.free_num = 0;
+    eurovision->states.used = 0;
+    eurovision->states.capacity = 0;
+    eurovision->epoch = 0;
+    eurovision->pending_votes = NULL;
+    eurovision->removals = 0;
+    eurovision->vote_table = NULL;
+    eurovision->cache.ids = NULL;
+    eurovision->cache.audience_scores = NULL;
+    eurovision->cache.judges_scores = NULL;
+    eurovision->cache.ranking = NULL;
+    cacheClear(&eurovision->cache);
+    if (!eurovision->country_map || !eurovision->judge_map ||
+        !eurovision->states.slots) {
         eurovisionDestroy(eurovision);
         return NULL;
     }
@@ -375,11 +1219,18 @@ void eurovisionDestroy(Eurovision eurovision) {
     if (!eurovision) {
         return;
     }
-    mapDestroy(eurovision->judge_map);
+    judgeMapDestroy(eurovision->judge_map);
     mapDestroy(eurovision->country_map);
+    directoryClear(&eurovision->states);
+    cacheClear(&eurovision->cache);
+    freeVoteChunks(eurovision->pending_votes);
+    voteTableDestroy(eurovision->vote_table);
     eurovision->judge_map = NULL;
     eurovision->country_map = NULL;
-    free(eurovision);
+    for (int i = 0; i < VOTE_STRIPES; i++) {
+        pthread_mutex_destroy(&eurovision->vote_stripes[i].lock);
+    }
+    memstatFree(eurovision);
 }
 
 EurovisionResult eurovisionAddState(Eurovision eurovision, int stateId,
@@ -388,6 +1239,10 @@ EurovisionResult eurovisionAddState(Eurovision eurovision, int stateId,
     if (!eurovision || !stateName || !songName) {
         return EUROVISION_NULL_ARGUMENT;
     }
+    if (mergeVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
     if (stateId < 0) {
         return EUROVISION_INVALID_ID;
     }
@@ -397,11 +1252,18 @@ EurovisionResult eurovisionAddState(Eurovision eurovision, int stateId,
     if (mapContains(eurovision->country_map, &stateId)) {
         return EUROVISION_STATE_ALREADY_EXIST;
     }
+    VoteTable *table = eurovision->vote_table;
     if (!createCountry(eurovision->country_map, stateId, stateName,
-                       songName)) {
+                       songName) ||
+        directoryAdd(&eurovision->states, stateId,
+                     getCountryName(eurovision->country_map, stateId),
+                     eurovision->removals) == ILLEGAL ||
+        (table && table->stride < eurovision->states.capacity &&
+         !tableResize(table, eurovision->states.capacity))) {
         eurovisionDestroy(eurovision);
         return EUROVISION_OUT_OF_MEMORY;
     }
+    eurovision->epoch++;
     return EUROVISION_SUCCESS;
 }
 
@@ -409,6 +1271,10 @@ EurovisionResult eurovisionRemoveState(Eurovision eurovision, int stateId) {
     if (!eurovision) {
         return EUROVISION_NULL_ARGUMENT;
     }
+    if (mergeVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
     if (stateId < 0) {
         return EUROVISION_INVALID_ID;
     }
@@ -416,34 +1282,34 @@ EurovisionResult eurovisionRemoveState(Eurovision eurovision, int stateId) {
         return EUROVISION_STATE_NOT_EXIST;
     }
     mapRemove(eurovision->country_map, &stateId);
-    int *judge_id = mapGetFirst(eurovision->judge_map), *judge_results;
-    bool judge_removed = false;
-    while (judge_id) {
-        judge_results = getJudgeResults(eurovision->judge_map, *judge_id);
+    if (eurovision->vote_table) {
+        tableClearSlot(eurovision->vote_table,
+                       directorySlot(&eurovision->states, stateId));
+    }
+    directoryRemove(&eurovision->states, stateId);
+    eurovision->epoch++;
+    eurovision->removals++;
+    int judge_id, *judge_results;
+    bool judge_removed;
+    for (int j = 0; j < judgeMapGetSize(eurovision->judge_map);) {
+        judge_id = judgeMapGetId(eurovision->judge_map, j);
+        judge_results = getJudgeResults(eurovision->judge_map, judge_id);
+        judge_removed = false;
         for (int i = 0; i < SIZE_OF_RANKING_ARRAY; i++) {
             if (*(judge_results + i) == stateId) {
-                mapRemove(eurovision->judge_map, judge_id);
+                judgeMapRemove(eurovision->judge_map, judge_id);
                 judge_removed = true;
                 break;
             }
         }
-        if (judge_removed) {
-            judge_id = mapGetFirst(eurovision->judge_map);
-            judge_removed = false;
-        } else {
-            judge_id = mapGetNext(eurovision->judge_map);
+        if (!judge_removed) {
+            j++;
         }
     }
-    int *country_id = mapGetFirst(eurovision->country_map);
-    Map votes_map;
-    while (country_id) {
-        votes_map = getVotesMap(eurovision->country_map, *country_id);
-        if (mapContains(votes_map, &stateId)) {
-            mapRemove(votes_map, &stateId);
-            country_id = mapGetFirst(eurovision->country_map);
-        } else {
-            country_id = mapGetNext(eurovision->country_map);
-        }
+    for (int i = 0; i < SlotMapGetSize(eurovision->states.slots); i++) {
+        mapRemove(getVotesMap(eurovision->country_map,
+                              SlotMapKeyAt(eurovision->states.slots, i)),
+                  &stateId);
     }
     return EUROVISION_SUCCESS;
 }
@@ -454,6 +1320,10 @@ EurovisionResult eurovisionAddJudge(Eurovision eurovision, int judgeId,
     if (!eurovision || !judgeName || !judgeResults) {
         return EUROVISION_NULL_ARGUMENT;
     }
+    if (mergeVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
     if (judgeId < 0) {
         return EUROVISION_INVALID_ID;
     }
@@ -473,7 +1343,7 @@ EurovisionResult eurovisionAddJudge(Eurovision eurovision, int judgeId,
             return EUROVISION_STATE_NOT_EXIST;
         }
     }
-    if (mapContains(eurovision->judge_map, &judgeId)) {
+    if (judgeMapContains(eurovision->judge_map, judgeId)) {
         return EUROVISION_JUDGE_ALREADY_EXIST;
     }
 
@@ -482,6 +1352,7 @@ EurovisionResult eurovisionAddJudge(Eurovision eurovision, int judgeId,
         eurovisionDestroy(eurovision);
         return EUROVISION_OUT_OF_MEMORY;
     }
+    eurovision->epoch++;
     return EUROVISION_SUCCESS;
 }
 
@@ -489,13 +1360,18 @@ EurovisionResult eurovisionRemoveJudge(Eurovision eurovision, int judgeId) {
     if (!eurovision) {
         return EUROVISION_NULL_ARGUMENT;
     }
+    if (mergeVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
     if (judgeId < 0) {
         return EUROVISION_INVALID_ID;
     }
-    if (!mapContains(eurovision->judge_map, &judgeId)) {
+    if (!judgeMapContains(eurovision->judge_map, judgeId)) {
         return EUROVISION_JUDGE_NOT_EXIST;
     }
-    mapRemove(eurovision->judge_map, &judgeId);
+    judgeMapRemove(eurovision->judge_map, judgeId);
+    eurovision->epoch++;
     return EUROVISION_SUCCESS;
 }
 
@@ -509,8 +1385,120 @@ EurovisionResult eurovisionRemoveVote(Eurovision eurovision, int stateGiver,
     return voteUpdate(eurovision, stateGiver, stateTaker, REMOVE_VOTE);
 }
 
-List eurovisionRunAudienceFavorite(Eurovision eurovision) {
-    if (fillAudienceScore(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+EurovisionResult eurovisionMergeVotes(Eurovision eurovision) {
+    if (!eurovision) {
+        return EUROVISION_NULL_ARGUMENT;
+    }
+    if (syncVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    return EUROVISION_SUCCESS;
+}
+
+EurovisionResult eurovisionUseVoteTable(Eurovision eurovision) {
+    if (!eurovision) {
+        return EUROVISION_NULL_ARGUMENT;
+    }
+    if (syncVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    if (eurovision->vote_table) {
+        return EUROVISION_SUCCESS;
+    }
+    StateDirectory *states = &eurovision->states;
+    VoteTable *table = memstatMalloc(MEMSTAT_EUROVISION, sizeof(*table));
+    if (!table) {
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    table->stride = 0;
+    table->votes = NULL;
+    table->dirty = NULL;
+    if (!tableResize(table, states->capacity)) {
+        voteTableDestroy(table);
+        eurovisionDestroy(eurovision);
+        return EUROVISION_OUT_OF_MEMORY;
+    }
+    for (int giver = 0; giver < states->used; giver++) {
+        if (states->ids[giver] == ILLEGAL) {
+            continue;
+        }
+        Map votes_map = getVotesMap(eurovision->country_map,
+                                    states->ids[giver]);
+        int *row = table->votes + (long) giver * table->stride;
+        MAP_FOREACH(int *, taker_id, votes_map) {
+            row[directorySlot(states, *taker_id)] =
+                    *(int *) mapGet(votes_map, taker_id);
+        }
+    }
+    eurovision->vote_table = table;
+    return EUROVISION_SUCCESS;
+}
+
+EurovisionVoteWriter eurovisionCreateVoteWriter(Eurovision eurovision) {
+    if (!eurovision) {
+        return NULL;
+    }
+    EurovisionVoteWriter writer = memstatMalloc(MEMSTAT_EUROVISION,
+                                                sizeof(*writer));
+    if (!writer) {
+        return NULL;
+    }
+    writer->eurovision = eurovision;
+    writer->chunk = NULL;
+    return writer;
+}
+
+void eurovisionDestroyVoteWriter(EurovisionVoteWriter writer) {
+    eurovisionWriterFlush(writer);
+    memstatFree(writer);
+}
+
+EurovisionResult eurovisionWriterAddVote(EurovisionVoteWriter writer,
+                                         int stateGiver, int stateTaker) {
+    return bufferVote(writer, stateGiver, stateTaker, ADD_VOTE);
+}
+
+EurovisionResult eurovisionWriterRemoveVote(EurovisionVoteWriter writer,
+                                            int stateGiver, int stateTaker) {
+    return bufferVote(writer, stateGiver, stateTaker, REMOVE_VOTE);
+}
+
+EurovisionResult eurovisionWriterFlush(EurovisionVoteWriter writer) {
+    if (!writer) {
+        return EUROVISION_NULL_ARGUMENT;
+    }
+    if (writer->chunk && writer->chunk->size) {
+        pushVoteChunk(writer->eurovision, writer->chunk);
+        writer->chunk = NULL;
+    }
+    return EUROVISION_SUCCESS;
+}
+
+EurovisionMemoryStats eurovisionGetMemoryStats() {
+    EurovisionMemoryStats stats;
+    stats.map = memstatGet(MEMSTAT_MAP);
+    stats.judge = memstatGet(MEMSTAT_JUDGE);
+    stats.country = memstatGet(MEMSTAT_COUNTRY);
+    stats.eurovision = memstatGet(MEMSTAT_EUROVISION);
+    stats.simulation = memstatGet(MEMSTAT_SIMULATION);
+    stats.list = memstatGet(MEMSTAT_LIST);
+    stats.total = memstatGet(MEMSTAT_SUBSYSTEMS);
+    return stats;
+}
+
+/**
+ * this function returns the names of all the countries ordered by the points
+ * they got from the audience.
+ * @param eurovision
+ * @return
+ * NULL if an allocation failed, the eurovision is destroyed
+ * list of the names of all the countries otherwise
+ */
+static List runAudienceFavorite(Eurovision eurovision) {
+    if (fillTallies(eurovision) == EUROVISION_OUT_OF_MEMORY) {
         eurovisionDestroy(eurovision);
         return NULL;
     }
@@ -519,186 +1507,411 @@ List eurovisionRunAudienceFavorite(Eurovision eurovision) {
         eurovisionDestroy(eurovision);
         return NULL;
     }
-    int countries_num = mapGetSize(eurovision->country_map);
-    int country_score, max_country_score;
-    int *max_country_id, *country_id;
-    for (; countries_num > 0; countries_num--) {
-        max_country_id = mapGetFirst(eurovision->country_map);
-        country_id = mapGetNext(eurovision->country_map);
-        while (country_id) {
-            country_score = getAudienceScore(eurovision->country_map,
-                                             *country_id);
-            max_country_score = getAudienceScore(eurovision->country_map,
-                                                 *max_country_id);
-            if (country_score > max_country_score) {
-                max_country_id = country_id;
-            }
-            country_id = mapGetNext(eurovision->country_map);
-        }
-        putAudienceScore(eurovision->country_map, *max_country_id, USED);
-        listInsertLast(audience_favorite,
-                       getCountryName(eurovision->country_map,
-                                      *max_country_id));
+    ContestCache *cache = &eurovision->cache;
+    if (!cache->size) {
+        return audience_favorite;
+    }
+    ScoredCountry *scored = memstatMalloc(MEMSTAT_EUROVISION,
+                                          sizeof(*scored) * 2 * cache->size);
+    if (!scored || listReserve(audience_favorite, cache->size) !=
+                   LIST_SUCCESS) {
+        memstatFree(scored);
+        listDestroy(audience_favorite);
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    TRACE_BEGIN(span);
+    for (int i = 0; i < cache->size; i++) {
+        scored[i].id = cache->ids[i];
+        scored[i].score = cache->audience_scores[i];
+    }
+    rankingRadixSort(scored, cache->size, scored + cache->size);
+    bool failed = false;
+    for (int i = 0; i < cache->size && !failed; i++) {
+        failed = listInsertLast(audience_favorite,
+                                getCountryName(eurovision->country_map,
+                                               scored[i].id)) != LIST_SUCCESS;
+    }
+    TRACE_END(span, TRACE_RANKING);
+    memstatFree(scored);
+    if (failed) {
+        listDestroy(audience_favorite);
+        eurovisionDestroy(eurovision);
+        return NULL;
     }
     return audience_favorite;
 }
 
-List eurovisionRunContest(Eurovision eurovision, int audiencePercent) {
+List eurovisionRunAudienceFavorite(Eurovision eurovision) {
+    TRACE_BEGIN(span);
+    List audience_favorite = runAudienceFavorite(eurovision);
+    TRACE_END(span, TRACE_RUN_AUDIENCE_FAVORITE);
+    return audience_favorite;
+}
+
+/**
+ * this function ranks the countries of the contest and returns the names of
+ * the k best ranked countries. When k is a large part of the countries all of
+ * them are ranked, and the ranking is kept in the contest cache for the next
+ * calls.
+ * @param eurovision
+ * @param audiencePercent
+ * @param k - the number of countries to return, all of them if k is larger
+ * than the number of countries
+ * @return
+ * NULL if audiencePercent is illegal or an allocation failed
+ * list of the names of the k best ranked countries otherwise
+ */
+static List runContest(Eurovision eurovision, int audiencePercent, int k) {
     if (audiencePercent > PERCENT || audiencePercent < 1) {
         return NULL;
     }
-    if (fillAudienceScore(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+    if (fillTallies(eurovision) == EUROVISION_OUT_OF_MEMORY) {
         eurovisionDestroy(eurovision);
         return NULL;
     }
-    List final_score = listCreate(copyString, freeString);
-    if (!final_score) {
+    ContestCache *cache = &eurovision->cache;
+    List top_k = listCreate(copyString, freeString);
+    if (!top_k) {
         eurovisionDestroy(eurovision);
         return NULL;
     }
-    if (!mapGetSize(eurovision->country_map)) {
-        return final_score;
-    }
-    fillJudgeScore(eurovision);
-    int size = mapGetSize(eurovision->country_map);
-    int judge_num = mapGetSize(eurovision->judge_map), countries_num = size - 1;
-    double audience_score, judge_score, max_audience_score, max_judge_score;
-    int *max_country_id, *country_id;
-    for (; size > 0; size--) {
-        max_country_id = mapGetFirst(eurovision->country_map);
-        country_id = mapGetNext(eurovision->country_map);
-        while (country_id) {
-            audience_score = ((double) (getAudienceScore
-                    (eurovision->country_map, *country_id)) / countries_num)
-                             * (double) audiencePercent / PERCENT;
-            max_audience_score = ((double) (getAudienceScore
-                    (eurovision->country_map, *max_country_id)) / countries_num)
-                                 * (double) audiencePercent / PERCENT;
-            if (judge_num) {
-                max_judge_score = ((double) (getJudgesScore
-                        (eurovision->country_map, *max_country_id)) / judge_num)
-                                  * (double) (PERCENT - audiencePercent) /
-                                  PERCENT;
-                judge_score = ((double) (getJudgesScore
-                        (eurovision->country_map, *country_id)) / judge_num)
-                              * (double) (PERCENT - audiencePercent) / PERCENT;
-            } else {
-                max_judge_score = 0;
-                judge_score = 0;
-            }
-            if (audience_score + judge_score >
-                max_audience_score + max_judge_score) {
-                max_country_id = country_id;
+    if (k > cache->size) {
+        k = cache->size;
+    }
+    if (listReserve(top_k, k) != LIST_SUCCESS) {
+        listDestroy(top_k);
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    if (k > cache->size / TOP_K_SORT_DIVISOR &&
+        fillRanking(eurovision, audiencePercent) == EUROVISION_OUT_OF_MEMORY) {
+        listDestroy(top_k);
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    if (cache->ranking_percent == audiencePercent) {
+        TRACE_BEGIN(list_span);
+        for (int i = 0; i < k; i++) {
+            if (listInsertLast(top_k, getCountryName(eurovision->country_map,
+                                                     cache->ranking[i]))) {
+                listDestroy(top_k);
+                eurovisionDestroy(eurovision);
+                return NULL;
             }
-            country_id = mapGetNext(eurovision->country_map);
         }
-        putAudienceScore(eurovision->country_map, *max_country_id, USED);
-        putJudgesScore(eurovision->country_map, *max_country_id, USED);
-        if (listInsertLast(final_score, getCountryName(eurovision->country_map,
-                                                       *max_country_id))) {
-            listDestroy(final_score);
+        TRACE_END(list_span, TRACE_LIST_BUILD);
+        return top_k;
+    }
+    ScoredCountry *scored = memstatMalloc(MEMSTAT_EUROVISION,
+                                          sizeof(*scored) * (cache->size + k));
+    if (!scored) {
+        listDestroy(top_k);
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    ScoredCountry *top = scored + cache->size;
+    TRACE_BEGIN(ranking_span);
+    int judge_num = judgeMapGetSize(eurovision->judge_map);
+    for (int i = 0; i < cache->size; i++) {
+        scored[i].id = cache->ids[i];
+        scored[i].score = rankingContestScore(cache->audience_scores[i],
+                                              cache->judges_scores[i],
+                                              audiencePercent, cache->size - 1,
+                                              judge_num);
+    }
+    k = rankingTopK(scored, cache->size, k, top);
+    TRACE_END(ranking_span, TRACE_RANKING);
+    TRACE_BEGIN(list_span);
+    for (int i = 0; i < k; i++) {
+        if (listInsertLast(top_k, getCountryName(eurovision->country_map,
+                                                 top[i].id))) {
+            memstatFree(scored);
+            listDestroy(top_k);
             eurovisionDestroy(eurovision);
             return NULL;
         }
     }
-    return final_score;
+    TRACE_END(list_span, TRACE_LIST_BUILD);
+    memstatFree(scored);
+    return top_k;
 }
 
-/**
- * this function gets a list with the countries id for each two countries it
- * fetches their votes and checks if they are friendly countries, in case they
- * are it combines the names into one sorted string and inserts into the
- * friendly countries list.
- * @param eurovision
- * @param id_list countries ID list
- * @param friendly_country_list
- * @return
- * false if a memory allocation failed
- * true if everything went well
- */
-static bool fillFriendlyCountries(Eurovision eurovision, List id_list, List
-                                  friendly_country_list) {
-    Map current_votes_map, next_votes_map;
-    int *current_id = listGetFirst(id_list);
-    int *next_id = listGetNext(id_list);
-    while (current_id) {
-        while (next_id) {
-            current_votes_map = (getVotesMap(eurovision->country_map,
-                                             *current_id));
-            next_votes_map = (getVotesMap(eurovision->country_map, *next_id));
-            if ((findMax(current_votes_map)== *(int *) next_id) &&
-                (findMax(next_votes_map)== *(int *) current_id)) {
-                char *first_country = getCountryName
-                        (eurovision->country_map, *current_id);
-                char *second_country = getCountryName
-                        (eurovision->country_map, *next_id);
-                char *friendly_country = combineNames(first_country,
-                                                      second_country);
-                if (!friendly_country) {
-                    listDestroy(friendly_country_list);
-                    listDestroy(id_list);
-                    eurovisionDestroy(eurovision);
-                    return false;
-                }
-                if (listInsertLast(friendly_country_list, friendly_country)) {
-                    free(friendly_country);
-                    listDestroy(friendly_country_list);
-                    listDestroy(id_list);
-                    eurovisionDestroy(eurovision);
-                    return false;
-                }
-                free(friendly_country);
-                removeElementFromList(id_list, current_id);
-                removeElementFromList(id_list, next_id);
-                current_id = listGetFirst(id_list);
-            }
-            next_id = listGetNext(id_list);
-        }
-        removeElementFromList(id_list, current_id);
-        current_id = listGetFirst(id_list);
-        next_id = listGetNext(id_list);
+List eurovisionRunContest(Eurovision eurovision, int audiencePercent) {
+    if (!eurovision) {
+        return NULL;
     }
-    return true;
+    TRACE_BEGIN(span);
+    List ranking = runContest(eurovision, audiencePercent,
+                              mapGetSize(eurovision->country_map));
+    TRACE_END(span, TRACE_RUN_CONTEST);
+    return ranking;
 }
 
-List eurovisionRunGetFriendlyStates(Eurovision eurovision) {
+List eurovisionRunContestTopK(Eurovision eurovision, int audiencePercent,
+                              int k) {
+    if (!eurovision || k < 1) {
+        return NULL;
+    }
+    TRACE_BEGIN(span);
+    List top_k = runContest(eurovision, audiencePercent, k);
+    TRACE_END(span, TRACE_RUN_CONTEST);
+    return top_k;
+}
+
+Simulation eurovisionCreateSimulation(Eurovision eurovision) {
     if (!eurovision) {
         return NULL;
     }
-    List friendly_country_list = listCreate(copyString, freeString);
-    if (!friendly_country_list) {
+    if (fillTallies(eurovision) == EUROVISION_OUT_OF_MEMORY) {
         eurovisionDestroy(eurovision);
         return NULL;
     }
-    if (!mapGetSize(eurovision->country_map)) {
-        return friendly_country_list;
+    ContestCache *cache = &eurovision->cache;
+    int *vote_offsets = memstatMalloc(MEMSTAT_EUROVISION,
+                                      sizeof(int) * (cache->size + 1));
+    if (!vote_offsets) {
+        eurovisionDestroy(eurovision);
+        return NULL;
     }
-    List id_list = listCreate(copyInt, freeInt);
-    if (!id_list) {
-        listDestroy(friendly_country_list);
+    vote_offsets[0] = 0;
+    for (int i = 0; i < cache->size; i++) {
+        vote_offsets[i + 1] = vote_offsets[i] + mapGetSize
+                (getVotesMap(eurovision->country_map, cache->ids[i]));
+    }
+    int *vote_takers = memstatMalloc(MEMSTAT_EUROVISION, sizeof(int) *
+                                     (vote_offsets[cache->size] + 1));
+    int *vote_counts = memstatMalloc(MEMSTAT_EUROVISION, sizeof(int) *
+                                     (vote_offsets[cache->size] + 1));
+    if (!vote_takers || !vote_counts) {
+        memstatFree(vote_offsets);
+        memstatFree(vote_takers);
+        memstatFree(vote_counts);
         eurovisionDestroy(eurovision);
         return NULL;
     }
-    int *current_id = mapGetFirst(eurovision->country_map);
-    while (current_id) {
-        if (listInsertLast(id_list, current_id)) {
-            listDestroy(friendly_country_list);
-            listDestroy(id_list);
-            eurovisionDestroy(eurovision);
+    Map votes_map;
+    int vote = 0;
+    for (int i = 0; i < cache->size; i++) {
+        votes_map = getVotesMap(eurovision->country_map, cache->ids[i]);
+        MAP_FOREACH(int *, taker_id, votes_map) {
+            vote_takers[vote] = *taker_id;
+            vote_counts[vote] = *(int *) mapGet(votes_map, taker_id);
+            vote++;
+        }
+    }
+    int judge_num = judgeMapGetSize(eurovision->judge_map);
+    Simulation simulation = simulationCreate(cache->size, cache->ids,
+                                             vote_offsets, vote_takers,
+                                             vote_counts, cache->judges_scores,
+                                             judge_num);
+    memstatFree(vote_offsets);
+    memstatFree(vote_takers);
+    memstatFree(vote_counts);
+    if (!simulation) {
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    return simulation;
+}
+
+/**
+ * this function ranks the countries of the contest for each of the given
+ * audience percents, the same as eurovisionRunContestSweep after its
+ * arguments were checked.
+ * @param eurovision
+ * @param audiencePercents
+ * @param scenariosNum
+ * @param statesNum - receives the number of countries in each ranking
+ * @return
+ * NULL if an allocation failed, the eurovision is destroyed
+ * the rankings of all the scenarios one after the other otherwise
+ */
+static int *runContestSweep(Eurovision eurovision,
+                            const int *audiencePercents, int scenariosNum,
+                            int *statesNum) {
+    if (fillTallies(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    ContestCache *cache = &eurovision->cache;
+    int *rankings = malloc(sizeof(int) * ((long) scenariosNum * cache->size
+                                          + 1));
+    if (!rankings) {
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    *statesNum = cache->size;
+    if (!cache->size) {
+        return rankings;
+    }
+    int threads_num = scenariosNum < SWEEP_THREADS ? scenariosNum :
+                      SWEEP_THREADS;
+    SweepTask tasks[SWEEP_THREADS];
+    pthread_t threads[SWEEP_THREADS];
+    bool started[SWEEP_THREADS];
+    for (int i = 0; i < threads_num; i++) {
+        tasks[i].cache = cache;
+        tasks[i].judge_num = judgeMapGetSize(eurovision->judge_map);
+        tasks[i].audience_percents = audiencePercents;
+        tasks[i].first = (int) ((long) scenariosNum * i / threads_num);
+        tasks[i].last = (int) ((long) scenariosNum * (i + 1) / threads_num);
+        tasks[i].rankings = rankings;
+        /* the first range is ranked by the calling thread itself */
+        started[i] = i > 0 && !pthread_create(threads + i, NULL, runSweepTask,
+                                              tasks + i);
+    }
+    for (int i = 0; i < threads_num; i++) {
+        if (!started[i]) {
+            runSweepTask(tasks + i);
+        }
+    }
+    EurovisionResult result = EUROVISION_SUCCESS;
+    for (int i = 0; i < threads_num; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        if (tasks[i].result != EUROVISION_SUCCESS) {
+            result = tasks[i].result;
+        }
+    }
+    if (result != EUROVISION_SUCCESS) {
+        free(rankings);
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    return rankings;
+}
+
+int *eurovisionRunContestSweep(Eurovision eurovision,
+                               const int *audiencePercents, int scenariosNum,
+                               int *statesNum) {
+    if (!eurovision || !audiencePercents || !statesNum || scenariosNum < 1) {
+        return NULL;
+    }
+    for (int i = 0; i < scenariosNum; i++) {
+        if (audiencePercents[i] > PERCENT || audiencePercents[i] < 1) {
             return NULL;
         }
-        current_id = mapGetNext(eurovision->country_map);
     }
-    if(!fillFriendlyCountries(eurovision, id_list, friendly_country_list))
-    {
+    TRACE_BEGIN(span);
+    int *rankings = runContestSweep(eurovision, audiencePercents,
+                                    scenariosNum, statesNum);
+    TRACE_END(span, TRACE_RUN_CONTEST_SWEEP);
+    return rankings;
+}
+
+/**
+ * this function finds the pairs of friendly states and orders them by their
+ * combined names. The names of the states in pairs are ranked once, so the
+ * pairs are ordered by comparing integer ranks.
+ * @param eurovision
+ * @param pairs - room for a pair for every two slots
+ * @param favorites - room for the favorite of every slot
+ * @param ranks - room for two ranks for every slot
+ * @param members - room for every slot
+ * @return
+ * the number of pairs
+ */
+static int fillFriendlyPairs(Eurovision eurovision, FriendlyPair *pairs,
+                             int *favorites, int *ranks, NamedSlot *members) {
+    StateDirectory *states = &eurovision->states;
+    int *lead_ranks = ranks, *tail_ranks = ranks + states->used;
+    fillFavorites(eurovision, favorites);
+    int pairs_num = 0, members_num = 0;
+    for (int slot = 0; slot < states->used; slot++) {
+        int favorite = favorites[slot];
+        if (favorite > slot && favorites[favorite] == slot) {
+            pairs[pairs_num].first = slot;
+            pairs[pairs_num++].second = favorite;
+            members[members_num].slot = slot;
+            members[members_num++].name = states->names[slot];
+            members[members_num].slot = favorite;
+            members[members_num++].name = states->names[favorite];
+        }
+    }
+    rankNames(members, members_num, compareNames, tail_ranks);
+    rankNames(members, members_num, compareLeadNames, lead_ranks);
+    for (int i = 0; i < pairs_num; i++) {
+        FriendlyPair *pair = pairs + i;
+        if (tail_ranks[pair->second] < tail_ranks[pair->first]) {
+            int first = pair->second;
+            pair->second = pair->first;
+            pair->first = first;
+        }
+        pair->lead_rank = lead_ranks[pair->first];
+        pair->tail_rank = tail_ranks[pair->second];
+    }
+    qsort(pairs, pairs_num, sizeof(*pairs), comparePairs);
+    return pairs_num;
+}
+
+/**
+ * this function returns the sorted names of the pairs of friendly countries,
+ * two countries are friendly if each one gave the most votes to the other.
+ * The pairs are found already ordered, so the combined names are appended in
+ * order and never compared.
+ * @param eurovision
+ * @return
+ * NULL if an allocation failed, the eurovision is destroyed
+ * list of the names of the pairs otherwise
+ */
+static List runGetFriendlyStates(Eurovision eurovision) {
+    if (syncVotes(eurovision) == EUROVISION_OUT_OF_MEMORY) {
+        eurovisionDestroy(eurovision);
         return NULL;
     }
-    listDestroy(id_list);
-    if (listSort(friendly_country_list, stringSort)) {
+    /* the labels are written into a block owned by the list, so it takes
+     * them as is */
+    List friendly_country_list = listCreateBorrowing(copyString, freeString);
+    if (!friendly_country_list) {
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    int used = eurovision->states.used;
+    FriendlyPair *pairs = memstatMalloc(MEMSTAT_EUROVISION,
+                                        sizeof(*pairs) * (used / 2 + 1));
+    int *favorites = memstatMalloc(MEMSTAT_EUROVISION,
+                                   sizeof(int) * (3 * used + 1));
+    NamedSlot *members = memstatMalloc(MEMSTAT_EUROVISION,
+                                       sizeof(*members) * (used + 1));
+    if (!pairs || !favorites || !members) {
+        memstatFree(pairs);
+        memstatFree(favorites);
+        memstatFree(members);
+        listDestroy(friendly_country_list);
+        eurovisionDestroy(eurovision);
+        return NULL;
+    }
+    TRACE_BEGIN(pairs_span);
+    int pairs_num = fillFriendlyPairs(eurovision, pairs, favorites,
+                                      favorites + used, members);
+    TRACE_END(pairs_span, TRACE_FRIENDLY_PAIRS);
+    memstatFree(favorites);
+    memstatFree(members);
+    TRACE_BEGIN(list_span);
+    bool failed = listReserve(friendly_country_list, pairs_num) !=
+                  LIST_SUCCESS ||
+                  !insertPairLabels(&eurovision->states, pairs, pairs_num,
+                                    friendly_country_list);
+    TRACE_END(list_span, TRACE_LIST_BUILD);
+    memstatFree(pairs);
+    if (failed) {
         listDestroy(friendly_country_list);
         eurovisionDestroy(eurovision);
         return NULL;
     }
+    listSetBorrowing(friendly_country_list, false);
+    return friendly_country_list;
+}
+
+List eurovisionRunGetFriendlyStates(Eurovision eurovision) {
+    if (!eurovision) {
+        return NULL;
+    }
+    TRACE_BEGIN(span);
+    List friendly_country_list = runGetFriendlyStates(eurovision);
+    TRACE_END(span, TRACE_RUN_FRIENDLY_STATES);
     return friendly_country_list;
 }
 
@@ -2,6 +2,8 @@
 #define EUROVISION_H_
 
 #include "list.h"
+#include "simulation.h"
+#include "memstat.h"
 
 typedef enum eurovisionResult_t {
     EUROVISION_NULL_ARGUMENT,
@@ -19,6 +21,24 @@ typedef enum eurovisionResult_t {
 
 typedef struct eurovision_t *Eurovision;
 
+/**
+ * The memory counters of each subsystem and their sums, see memstat.h.
+ */
+typedef struct EurovisionMemoryStats_t {
+    MemstatCounters map;
+    MemstatCounters judge;
+    MemstatCounters country;
+    MemstatCounters eurovision;
+    MemstatCounters simulation;
+    MemstatCounters list;
+    MemstatCounters total;
+} EurovisionMemoryStats;
+
+/**
+ * A buffer of votes of one ingest thread, see eurovisionCreateVoteWriter.
+ */
+typedef struct EurovisionVoteWriter_t *EurovisionVoteWriter;
+
 Eurovision eurovisionCreate();
 
 void eurovisionDestroy(Eurovision eurovision);
@@ -35,16 +55,105 @@ EurovisionResult eurovisionAddJudge(Eurovision eurovision, int judgeId,
 
 EurovisionResult eurovisionRemoveJudge(Eurovision eurovision, int judgeId);
 
+/**
+ * eurovisionAddVote and eurovisionRemoveVote may be called by several threads
+ * at once, the votes of a giver state are guarded by one of a set of lock
+ * stripes, or changed atomically when a vote table is used. No other function
+ * may run on the same eurovision at the same time.
+ * On EUROVISION_OUT_OF_MEMORY the vote is lost but the eurovision is not
+ * destroyed, unlike the other functions, since other threads may still be
+ * voting in it.
+ */
 EurovisionResult eurovisionAddVote(Eurovision eurovision, int stateGiver,
                                    int stateTaker);
 
 EurovisionResult eurovisionRemoveVote(Eurovision eurovision, int stateGiver,
                                       int stateTaker);
 
+/**
+ * Creates a vote writer which buffers the votes of one thread. The votes are
+ * checked like eurovisionAddVote checks them and buffered in chunks, a full
+ * chunk is handed to the eurovision without taking a lock. Handed chunks are
+ * merged into the votes in the order they were handed, by eurovisionMergeVotes
+ * and at the start of every other function except the vote functions, so a
+ * buffered vote takes effect only then and is dropped if one of its states was
+ * removed by then. Votes are clamped at zero the same as eurovisionRemoveVote.
+ * Writers of different threads and eurovisionAddVote/eurovisionRemoveVote may
+ * run at the same time. A writer must be destroyed before its eurovision.
+ * On EUROVISION_OUT_OF_MEMORY from a writer the vote is lost but the eurovision
+ * is not destroyed, since other threads may still be using it.
+ * Returns NULL if eurovision is NULL or an allocation failed.
+ */
+EurovisionVoteWriter eurovisionCreateVoteWriter(Eurovision eurovision);
+
+/** Hands the buffered votes to the eurovision and frees the writer. */
+void eurovisionDestroyVoteWriter(EurovisionVoteWriter writer);
+
+EurovisionResult eurovisionWriterAddVote(EurovisionVoteWriter writer,
+                                         int stateGiver, int stateTaker);
+
+EurovisionResult eurovisionWriterRemoveVote(EurovisionVoteWriter writer,
+                                            int stateGiver, int stateTaker);
+
+/** Hands the votes buffered so far to the eurovision. */
+EurovisionResult eurovisionWriterFlush(EurovisionVoteWriter writer);
+
+/**
+ * Merges the votes handed by vote writers and the votes of the vote table into
+ * the contest now instead of at the start of the next function.
+ */
+EurovisionResult eurovisionMergeVotes(Eurovision eurovision);
+
+/**
+ * Moves the votes into a table of counters indexed by the dense slots of the
+ * states. While the table is used eurovisionAddVote is a single atomic add
+ * after the ids are checked, and eurovisionRemoveVote a compare and swap loop
+ * which never drops the votes below zero. The table takes the square of the
+ * number of slots in ints and grows when states are added. Changed rows of
+ * the table are written back at the start of every function except the vote
+ * functions.
+ */
+EurovisionResult eurovisionUseVoteTable(Eurovision eurovision);
+
 List eurovisionRunContest(Eurovision eurovision, int audiencePercent);
 
+/**
+ * Returns the names of the k best ranked states of the contest, in the same
+ * order eurovisionRunContest would return them, without ranking all states.
+ * Returns NULL if k is smaller than 1 or audiencePercent is out of range.
+ */
+List eurovisionRunContestTopK(Eurovision eurovision, int audiencePercent,
+                              int k);
+
+/**
+ * Ranks all the states once for every audience percent in audiencePercents,
+ * counting the audience and judges points only once for all of them.
+ * Returns an array of scenariosNum rows, row i holds the ids of all the states
+ * as eurovisionRunContest would rank them for audiencePercents[i]. statesNum
+ * receives the length of a row. The array should be released with free.
+ * Returns NULL if an argument is NULL or illegal, or an allocation failed.
+ */
+int *eurovisionRunContestSweep(Eurovision eurovision,
+                               const int *audiencePercents, int scenariosNum,
+                               int *statesNum);
+
+/**
+ * Creates a simulation from a snapshot of the current votes and judges points,
+ * see simulation.h. Later changes to the contest do not affect the simulation.
+ * Returns NULL if eurovision is NULL or an allocation failed.
+ */
+Simulation eurovisionCreateSimulation(Eurovision eurovision);
+
 List eurovisionRunAudienceFavorite(Eurovision eurovision);
 
+/**
+ * Returns the live bytes and allocations, the peak bytes and the number of
+ * allocations made so far by every subsystem. The counters are shared by all
+ * the contests of the process. Keys and data copied into maps by the element
+ * functions of the map user are counted by the user, not as map memory.
+ */
+EurovisionMemoryStats eurovisionGetMemoryStats();
+
 List eurovisionRunGetFriendlyStates(Eurovision eurovision);
 
 
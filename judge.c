@@ -1,8 +1,8 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
-#include "map.h"
 #include "judge.h"
+#include "memstat.h"
 #include <stdbool.h>
 #include <string.h>
 
@@ -11,151 +11,93 @@
 struct Judge_t
 {
     char* judge_name;
-    int* judge_results;
+    int judge_results[SIZE_OF_RANKING_ARRAY];
 };
 
-
 /**
-* Type of function used by the map to copy key elements.
- * @param key
-* This function should return:
-* 		NULL if a null argument was sent or allocations failed
- * 		The copied key
+* The judges are stored by value in a map keyed by the judge id, so looking
+* a judge up compares ints inline and takes no extra allocation per judge.
 */
-static MapKeyElement copyInt(MapKeyElement key) {
-    if (!key) {
-        return NULL;
+DEFINE_MAP_FUNCTIONS(JudgeMap, int, struct Judge_t)
+
+JudgeMap judgeMapCreate()
+{
+    return JudgeMapCreate();
+}
+
+void judgeMapDestroy(JudgeMap map)
+{
+    if (!map) {
+        return;
     }
-    int *copy = malloc(sizeof(*copy));
-    if (!copy) {
-        return NULL;
+    for (int i = 0; i < JudgeMapGetSize(map); i++) {
+        memstatFree(JudgeMapValueAt(map, i)->judge_name);
     }
-    *copy = *(int *) key;
-    return copy;
+    JudgeMapDestroy(map);
 }
 
-
-/**
-* Type of function used by the map to copy a whole judge.
- * it allocates memory for the judge's name and votes array and
- * fills them according to the given country
- *
- * @param judge
-* This function should return:
-* 		NULL if a null argument was sent or allocations failed
- * 		The copied judge
-*/
-static MapDataElement copyDataJudge(MapDataElement judge) {
-    if (!judge) {
-        return NULL;
-    }
-    Judge copy = malloc(sizeof(*copy));
-    if (!copy) {
+Judge createJudge(JudgeMap map, int judge_id, const char *judge_name,
+                  int *judge_results)
+{
+    if (!map || !judge_name || !judge_results) {
         return NULL;
     }
-    char* copyName=malloc(sizeof(char)*(strlen(((Judge)judge)->judge_name)+1));
-    if(!copyName )
+    struct Judge_t judge;
+    for(int i=0 ; i<SIZE_OF_RANKING_ARRAY ; i++)
     {
-        free(copyName);
-        free(copy);
-        return NULL;
+        judge.judge_results[i]=*(judge_results+i);
     }
-    strcpy(copyName,((Judge)judge)->judge_name);
-    copy->judge_name=copyName;
-    copy->judge_results=malloc(sizeof(int)*SIZE_OF_RANKING_ARRAY);
-    if(!copy->judge_results)
-    {
-        free(copyName);
-        free(copy);
+    judge.judge_name = memstatMalloc(MEMSTAT_JUDGE,
+                                     sizeof(char) * (strlen(judge_name) + 1));
+    if (!judge.judge_name) {
         return NULL;
     }
-    for(int i=0 ; i<SIZE_OF_RANKING_ARRAY ; i++)
-    {
-        *(copy->judge_results+i)=*(((Judge)judge)->judge_results+i);
+    strcpy(judge.judge_name, judge_name);
+    Judge old_judge = JudgeMapGet(map, judge_id);
+    char *old_name = old_judge ? old_judge->judge_name : NULL;
+    if (JudgeMapPut(map, judge_id, judge) != MAP_SUCCESS) {
+        memstatFree(judge.judge_name);
+        return NULL;
     }
-    return (MapDataElement) copy;
-}
-
-/**
-* Type of function used by the map to to free the key element.
-* @param key
-*/
-static void freeInt(MapKeyElement key) {
-    free(key);
+    memstatFree(old_name);
+    return JudgeMapGet(map, judge_id);
 }
 
-/**
-* Type of function used by the map to to free judge
- * using the destroy function that clears the judge  .
-* @param key
-*/
-static void freeJudge(MapDataElement judge) {
-    judgeDestroy(judge);
-}
-
-/**
-* Type of function used by the map to identify equal key elements.
-* This function should return:
-* 		A positive integer if the first element is greater;
-* 		0 if they're equal;
-*		A negative integer if the second element is greater.
-*/
-static int compareInts(MapKeyElement key1, MapKeyElement key2) {
-    return (*(int *) key1 - *(int *) key2);
+JudgeResult judgeMapRemove(JudgeMap map, int judge_id)
+{
+    if (!map) {
+        return JUDGE_NULL_ARGUMENT;
+    }
+    Judge judge = JudgeMapGet(map, judge_id);
+    if (!judge) {
+        return JUDGE_NOT_EXIST;
+    }
+    memstatFree(judge->judge_name);
+    JudgeMapRemove(map, judge_id);
+    return JUDGE_SUCCESS;
 }
 
-Map judgeMapCreate()
+bool judgeMapContains(JudgeMap map, int judge_id)
 {
-    return mapCreate(copyDataJudge, copyInt, freeJudge, freeInt, compareInts);
+    return JudgeMapContains(map, judge_id);
 }
 
-Judge createJudge(Map map, int judge_id, const char *judge_name,
-                  int *judge_results)
+int judgeMapGetSize(JudgeMap map)
 {
-    Judge judge = malloc(sizeof(*judge));
-    if (!judge) {
-        return NULL;
-    }
-    judge->judge_results=malloc(sizeof(int)*SIZE_OF_RANKING_ARRAY);
-    if (!judge->judge_results) {
-        free(judge);
-        return NULL;
-    }
-    for(int i=0 ; i<SIZE_OF_RANKING_ARRAY ; i++)
-    {
-        *((judge->judge_results)+i)=*(judge_results+i);
-    }
-    char* copyName = malloc(sizeof(char) * (strlen(judge_name) + 1));
-    if (!copyName) {
-        judgeDestroy(judge);
-        return NULL;
-    }
-    strcpy(copyName, judge_name);
-    judge->judge_name = copyName;
-    if (mapPut(map, &judge_id, judge)) {
-        judgeDestroy(judge);
-        return NULL;
-    }
-    judgeDestroy(judge);
-    return judge;
+    return JudgeMapGetSize(map);
 }
 
-void judgeDestroy(Judge judge)
+int judgeMapGetId(JudgeMap map, int index)
 {
-    free(judge->judge_name);
-    free(judge->judge_results);
-    free(judge);
+    return JudgeMapKeyAt(map, index);
 }
 
-int* getJudgeResults(Map map, int judge_id)
+int* getJudgeResults(JudgeMap map, int judge_id)
 {
-    Judge judge=mapGet(map, &judge_id);
+    Judge judge=JudgeMapGet(map, judge_id);
     if(!judge)
     {
         return NULL;
     }
     return judge->judge_results;
 }
-
-
-
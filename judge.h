@@ -1,14 +1,19 @@
 #ifndef JUDGE_H
 #define JUDGE_H
 
-#include "map.h"
+#include "typed_map.h"
 #include <stdbool.h>
 
 /**
 * The following functions are available:
 *   judgeMapCreate	- Creates a new empty map.
+*   judgeMapDestroy	- Deletes an existing map and all its judges.
 *   createJudge      - Creates a new judge node.
-*   judgeDestroy	- Deletes an existing judge and frees all resources.
+*   judgeMapRemove	- Removes a judge from the map.
+*   judgeMapContains	- Returns weather or not a judge id is in the map.
+*   judgeMapGetSize	- Returns the number of judges in the map.
+*   judgeMapGetId	- Returns the judge id at a given index, the ids are
+                        ordered from the smallest.
 *   getJudgeResults        -returns the array that contains
                         the votes of the selected judge.
 */
@@ -16,11 +21,16 @@
 /** Type for defining the judge */
 typedef struct Judge_t *Judge;
 
+/** Type for defining the map of judges, the judges are kept by id in a
+* typed map (see typed_map.h) */
+DECLARE_MAP(JudgeMap)
+
 /** Type used for returning error codes from judge functions */
 typedef enum JudgeResult_t {
     JUDGE_SUCCESS,
     JUDGE_OUT_OF_MEMORY,
     JUDGE_NULL_ARGUMENT,
+    JUDGE_NOT_EXIST,
 } JudgeResult;
 
 /**
@@ -28,9 +38,17 @@ typedef enum JudgeResult_t {
 *
 * 	@return
  * 	NULL - if one of the parameters is NULL or allocations failed.
-* 	A new Map in case of success.
+* 	A new JudgeMap in case of success.
 */
-Map judgeMapCreate();
+JudgeMap judgeMapCreate();
+
+/**
+* judgeMapDestroy: Deallocates an existing map and all the judges in it.
+*
+* @param map - Target map to be deallocated. If map is NULL
+ * nothing will be done
+*/
+void judgeMapDestroy(JudgeMap map);
 
 /**
 * createJudge: Allocates a new judge and adds it to the given map.
@@ -41,20 +59,53 @@ Map judgeMapCreate();
 * @param judge_results
 * @return
 * 	NULL - if one of the parameters is NULL or allocations failed.
-* 	A new judge in case of success.
+* 	The new judge in case of success, valid until the map changes.
 */
-Judge createJudge(Map map, int judge_id,const char *judge_name,
+Judge createJudge(JudgeMap map, int judge_id,const char *judge_name,
                   int *judge_results);
 
 /**
-* judgeDestroy: Deallocates an existing judge.
- * Clears all elements by using the
-* stored free functions.
+* judgeMapRemove: Removes a judge from the map and frees it.
 *
-* @param judge - Target judge to be deallocated. If country is NULL
- * nothing will be done
+* @param map
+* @param judge_id
+* @return
+* 	JUDGE_NULL_ARGUMENT - if a NULL was sent as map.
+* 	JUDGE_NOT_EXIST - if the map does not contain the judge_id.
+* 	JUDGE_SUCCESS - otherwise.
+*/
+JudgeResult judgeMapRemove(JudgeMap map, int judge_id);
+
+/**
+* judgeMapContains: Checks if a judge id exists in the map.
+*
+* @param map
+* @param judge_id
+* @return
+* 	false - if a NULL was sent or the judge id was not found.
+* 	true - if the judge id was found in the map.
+*/
+bool judgeMapContains(JudgeMap map, int judge_id);
+
+/**
+* judgeMapGetSize: Returns the number of judges in the map.
+*
+* @param map
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of judges in the map.
+*/
+int judgeMapGetSize(JudgeMap map);
+
+/**
+* judgeMapGetId: Returns the id of the judge at the given index, indices
+ * from 0 to the size of the map minus one go over the ids from the smallest.
+*
+* @param map - a map which is not NULL
+* @param index - an index between 0 and the size of the map minus one
+* @return the judge id at the index
 */
-void judgeDestroy(Judge judge);
+int judgeMapGetId(JudgeMap map, int index);
 
 /**
 *	getJudgeResults: Returns the votes array associated with a specific
@@ -66,6 +117,6 @@ void judgeDestroy(Judge judge);
  *  does not contain the requested judge_id.
 * 	The country_name associated with the judge_id otherwise.
 */
-int* getJudgeResults(Map map, int judge_id);
+int* getJudgeResults(JudgeMap map, int judge_id);
 
 #endif //JUDGE_H
@@ -0,0 +1,465 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "list.h"
+#include "memstat.h"
+
+#define ILLEGAL -1
+#define FIRST_CAPACITY 4
+
+/**
+ * The list keeps its elements in one array in list order, so iterating and
+ * sorting go over consecutive pointers. current is the index of the internal
+ * iterator, ILLEGAL when it is invalid. storage is the block given by
+ * listSetStorage, NULL if there is none.
+ */
+struct List_t
+{
+    CopyListElement copy;
+    FreeListElement free;
+    bool borrowing;
+    ListElement* elements;
+    int size;
+    int capacity;
+    int current;
+    char* storage;
+    size_t storage_size;
+    FreeListElement free_storage;
+};
+
+/**
+ * this function allocates an empty list.
+ *
+ * @param copyElement
+ * @param freeElement
+ * @param borrowing - whether inserted elements are kept instead of copied
+ * @return :
+ * NULL if one of the functions is NULL or the allocation fails
+ * the new list otherwise
+ */
+static List createList(CopyListElement copyElement,
+                       FreeListElement freeElement, bool borrowing);
+
+/**
+ * this function makes room for at least capacity elements in the array of a
+ * list.
+ *
+ * @param list
+ * @param capacity
+ * @return :
+ * false if the allocation fails, the list is left unchanged
+ * true otherwise
+ */
+static bool reserve(List list, int capacity);
+
+/**
+ * this function inserts an element at an index of the list, a copy of it
+ * unless the list is borrowing. The internal iterator keeps pointing to the
+ * same element.
+ *
+ * @param list
+ * @param index - from 0 to the size of the list
+ * @param element
+ * @return :
+ * LIST_NULL_ARGUMENT if a NULL element was sent to a borrowing list
+ * LIST_OUT_OF_MEMORY if an allocation fails, the list is left unchanged
+ * LIST_SUCCESS if the element was inserted successfully
+ */
+static ListResult insertAt(List list, int index, ListElement element);
+
+/**
+ * this function frees an element of the list, unless it lies in the storage
+ * block of the list.
+ *
+ * @param list
+ * @param element
+ */
+static void freeElement(List list, ListElement element);
+
+/**
+ * this function merges two sorted runs of elements into out, taking from the
+ * left run on equal elements so the sort is stable.
+ *
+ * @param left
+ * @param left_size
+ * @param right
+ * @param right_size
+ * @param out - room for both runs
+ * @param compareElement
+ */
+static void mergeRuns(ListElement* left, int left_size, ListElement* right,
+                      int right_size, ListElement* out,
+                      CompareListElements compareElement);
+
+List listCreate(CopyListElement copyElement, FreeListElement freeElement)
+{
+    return createList(copyElement,freeElement,false);
+}
+
+List listCreateBorrowing(CopyListElement copyElement,
+                         FreeListElement freeElement)
+{
+    return createList(copyElement,freeElement,true);
+}
+
+ListResult listSetBorrowing(List list, bool borrowing)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    list->borrowing=borrowing;
+    return LIST_SUCCESS;
+}
+
+ListResult listReserve(List list, int capacity)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    return reserve(list,capacity) ? LIST_SUCCESS : LIST_OUT_OF_MEMORY;
+}
+
+ListResult listSetStorage(List list, void* storage, size_t size,
+                          FreeListElement freeStorage)
+{
+    if(!list || !freeStorage)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    assert(!list->storage);
+    list->storage=storage;
+    list->storage_size=storage ? size : 0;
+    list->free_storage=freeStorage;
+    return LIST_SUCCESS;
+}
+
+List listCopy(List list)
+{
+    if(!list)
+    {
+        return NULL;
+    }
+    List new_list=createList(list->copy,list->free,false);
+    if(!new_list || !reserve(new_list,list->size))
+    {
+        listDestroy(new_list);
+        return NULL;
+    }
+    for(int i=0;i<list->size;i++)
+    {
+        new_list->elements[i]=list->copy(list->elements[i]);
+        if(!new_list->elements[i])
+        {
+            listDestroy(new_list);
+            return NULL;
+        }
+        (new_list->size)++;
+    }
+    new_list->current=list->current;
+    return new_list;
+}
+
+int listGetSize(List list)
+{
+    if(!list)
+    {
+        return ILLEGAL;
+    }
+    return list->size;
+}
+
+ListElement listGetFirst(List list)
+{
+    if(!list)
+    {
+        return NULL;
+    }
+    if(list->size==0)
+    {
+        list->current=ILLEGAL;
+        return NULL;
+    }
+    list->current=0;
+    return list->elements[0];
+}
+
+ListElement listGetNext(List list)
+{
+    if(!list || list->current==ILLEGAL)
+    {
+        return NULL;
+    }
+    if(list->current+1>=list->size)
+    {
+        list->current=ILLEGAL;
+        return NULL;
+    }
+    (list->current)++;
+    return list->elements[list->current];
+}
+
+ListElement listGetCurrent(List list)
+{
+    if(!list || list->current==ILLEGAL)
+    {
+        return NULL;
+    }
+    return list->elements[list->current];
+}
+
+ListResult listInsertFirst(List list, ListElement element)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    return insertAt(list,0,element);
+}
+
+ListResult listInsertLast(List list, ListElement element)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    return insertAt(list,list->size,element);
+}
+
+ListResult listInsertBeforeCurrent(List list, ListElement element)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    if(list->current==ILLEGAL)
+    {
+        return LIST_INVALID_CURRENT;
+    }
+    return insertAt(list,list->current,element);
+}
+
+ListResult listInsertAfterCurrent(List list, ListElement element)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    if(list->current==ILLEGAL)
+    {
+        return LIST_INVALID_CURRENT;
+    }
+    return insertAt(list,list->current+1,element);
+}
+
+ListResult listRemoveCurrent(List list)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    if(list->current==ILLEGAL)
+    {
+        return LIST_INVALID_CURRENT;
+    }
+    freeElement(list,list->elements[list->current]);
+    (list->size)--;
+    memmove(list->elements+list->current,list->elements+list->current+1,
+            sizeof(*(list->elements))*(list->size-list->current));
+    list->current=ILLEGAL;
+    return LIST_SUCCESS;
+}
+
+ListResult listSort(List list, CompareListElements compareElement)
+{
+    if(!list || !compareElement)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    if(list->size<2)
+    {
+        return LIST_SUCCESS;
+    }
+    ListElement* tmp=memstatMalloc(MEMSTAT_LIST,sizeof(*tmp)*list->size);
+    if(!tmp)
+    {
+        return LIST_OUT_OF_MEMORY;
+    }
+    ListElement* from=list->elements;
+    ListElement* to=tmp;
+    for(int width=1;width<list->size;width*=2)
+    {
+        for(int low=0;low<list->size;low+=2*width)
+        {
+            int middle=low+width<list->size ? low+width : list->size;
+            int high=middle+width<list->size ? middle+width : list->size;
+            mergeRuns(from+low,middle-low,from+middle,high-middle,to+low,
+                      compareElement);
+        }
+        ListElement* swap=from;
+        from=to;
+        to=swap;
+    }
+    if(from!=list->elements)
+    {
+        memcpy(list->elements,from,sizeof(*from)*list->size);
+    }
+    memstatFree(tmp);
+    list->current=ILLEGAL;
+    return LIST_SUCCESS;
+}
+
+List listFilter(List list, FilterListElement filterElement, ListFilterKey key)
+{
+    if(!list || !filterElement)
+    {
+        return NULL;
+    }
+    List new_list=createList(list->copy,list->free,false);
+    if(!new_list)
+    {
+        return NULL;
+    }
+    for(int i=0;i<list->size;i++)
+    {
+        if(filterElement(list->elements[i],key) &&
+           insertAt(new_list,new_list->size,list->elements[i])!=LIST_SUCCESS)
+        {
+            listDestroy(new_list);
+            return NULL;
+        }
+    }
+    return new_list;
+}
+
+ListResult listClear(List list)
+{
+    if(!list)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    for(int i=0;i<list->size;i++)
+    {
+        freeElement(list,list->elements[i]);
+    }
+    list->size=0;
+    list->current=ILLEGAL;
+    return LIST_SUCCESS;
+}
+
+void listDestroy(List list)
+{
+    if(!list)
+    {
+        return;
+    }
+    listClear(list);
+    if(list->storage)
+    {
+        list->free_storage(list->storage);
+    }
+    memstatFree(list->elements);
+    memstatFree(list);
+}
+
+static List createList(CopyListElement copyElement,
+                       FreeListElement freeElement, bool borrowing)
+{
+    if(!copyElement || !freeElement)
+    {
+        return NULL;
+    }
+    List list=memstatMalloc(MEMSTAT_LIST,sizeof(*list));
+    if(!list)
+    {
+        return NULL;
+    }
+    list->copy=copyElement;
+    list->free=freeElement;
+    list->borrowing=borrowing;
+    list->elements=NULL;
+    list->size=0;
+    list->capacity=0;
+    list->current=ILLEGAL;
+    list->storage=NULL;
+    list->storage_size=0;
+    list->free_storage=NULL;
+    return list;
+}
+
+static bool reserve(List list, int capacity)
+{
+    if(capacity<=list->capacity)
+    {
+        return true;
+    }
+    ListElement* elements=memstatRealloc(MEMSTAT_LIST,list->elements,
+                                         sizeof(*elements)*capacity);
+    if(!elements)
+    {
+        return false;
+    }
+    list->elements=elements;
+    list->capacity=capacity;
+    return true;
+}
+
+static ListResult insertAt(List list, int index, ListElement element)
+{
+    if(list->size==list->capacity &&
+       !reserve(list,list->capacity ? 2*list->capacity : FIRST_CAPACITY))
+    {
+        return LIST_OUT_OF_MEMORY;
+    }
+    if(list->borrowing && !element)
+    {
+        return LIST_NULL_ARGUMENT;
+    }
+    ListElement copy=list->borrowing ? element : list->copy(element);
+    if(!copy)
+    {
+        return LIST_OUT_OF_MEMORY;
+    }
+    memmove(list->elements+index+1,list->elements+index,
+            sizeof(*(list->elements))*(list->size-index));
+    list->elements[index]=copy;
+    (list->size)++;
+    if(list->current!=ILLEGAL && list->current>=index)
+    {
+        (list->current)++;
+    }
+    return LIST_SUCCESS;
+}
+
+static void freeElement(List list, ListElement element)
+{
+    uintptr_t address=(uintptr_t)element;
+    uintptr_t start=(uintptr_t)list->storage;
+    if(list->storage && address>=start && address-start<list->storage_size)
+    {
+        return;
+    }
+    list->free(element);
+}
+
+static void mergeRuns(ListElement* left, int left_size, ListElement* right,
+                      int right_size, ListElement* out,
+                      CompareListElements compareElement)
+{
+    int i=0, j=0;
+    while(i<left_size && j<right_size)
+    {
+        if(compareElement(right[j],left[i])<0)
+        {
+            *(out++)=right[j++];
+        }
+        else
+        {
+            *(out++)=left[i++];
+        }
+    }
+    memcpy(out,left+i,sizeof(*left)*(left_size-i));
+    memcpy(out+left_size-i,right+j,sizeof(*right)*(right_size-j));
+}
@@ -2,10 +2,13 @@
 #define LIST_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 /**
 * Generic List Container
 *
 * Implements a list container type.
+* The elements are kept in one growable array in list order, so iterating is
+* a scan of consecutive pointers and listSort is a stable merge sort.
 * The list his an internal iterator for external use. For all functions
 * where the state of the iterator after calling that function is not stated,
 * it is undefined. That is you cannot assume anything about it.
@@ -35,6 +38,11 @@
 *   listFilter               - Creates a copy of an existing list, filtered by
 *                              a boolean predicate
 *   listClear		      	  - Clears all the data from the list
+*   listCreateBorrowing      - Creates a new empty list which takes the
+*                              inserted elements instead of copying them
+*   listSetBorrowing         - Sets whether a list copies inserted elements
+*   listReserve              - Makes room for a number of elements
+*   listSetStorage           - Gives the list a block holding its elements
 */
 
 /** Type for defining the list */
@@ -134,6 +142,72 @@ typedef bool(*FilterListElement)(ListElement, ListFilterKey);
 */
 List listCreate(CopyListElement copyElement, FreeListElement freeElement);
 
+/**
+* Allocates a new borrowing List.
+*
+* The same as listCreate, except that inserted elements are not copied: the
+* list keeps the element it was given, and frees it with freeElement like any
+* other element. The caller must not use or free an element after inserting
+* it successfully, an element whose insertion failed is left to the caller.
+* copyElement is still used by listCopy and listFilter, whose lists copy
+* their elements as usual.
+*
+* @param copyElement Function pointer to be used for copying elements when
+* copying the list.
+* @param freeElement Function pointer to be used for removing elements from
+* the list.
+* @return
+* 	NULL - if one of the parameters is NULL or allocations failed.
+* 	A new List in case of success.
+*/
+List listCreateBorrowing(CopyListElement copyElement,
+                         FreeListElement freeElement);
+
+/**
+* Sets whether the list takes inserted elements instead of copying them, see
+* listCreateBorrowing. Elements already in the list are not changed, so a list
+* filled while borrowing can be handed to code expecting a copying list.
+*
+* @param list The target list
+* @param borrowing Whether elements inserted from now on are taken as is
+* @return
+* LIST_NULL_ARGUMENT if a NULL was sent as list
+* LIST_SUCCESS otherwise
+*/
+ListResult listSetBorrowing(List list, bool borrowing);
+
+/**
+* Makes room for at least capacity elements, so inserting up to that many
+* elements does not allocate again. The elements and iterator are unchanged.
+*
+* @param list The target list
+* @param capacity The number of elements to make room for
+* @return
+* LIST_NULL_ARGUMENT if a NULL was sent as list
+* LIST_OUT_OF_MEMORY if an allocation failed, the list is unchanged
+* LIST_SUCCESS otherwise
+*/
+ListResult listReserve(List list, int capacity);
+
+/**
+* Gives the list one block of memory that elements inserted while borrowing
+* may point into, so many elements can be made with a single allocation.
+* The list owns the block from now on: elements inside it are never freed on
+* their own, and the block is freed with freeStorage when the list is
+* destroyed. Copies of the list copy the elements out of the block as usual.
+* A list holds at most one block.
+*
+* @param list The target list
+* @param storage The block, may be NULL if size is 0
+* @param size The size of the block in bytes
+* @param freeStorage Function pointer to be used for freeing the block
+* @return
+* LIST_NULL_ARGUMENT if a NULL was sent as list or freeStorage
+* LIST_SUCCESS otherwise
+*/
+ListResult listSetStorage(List list, void* storage, size_t size,
+                          FreeListElement freeStorage);
+
 /**
 * Creates a copy of target list.
 *
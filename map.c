@@ -1,19 +1,43 @@
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdio.h>
 #include "map.h"
+#include "memstat.h"
 #include <stdbool.h>
 
 #define ILLEGAL -1
+/* 16 pointers fill two cache lines, for the keys and for the values */
+#define NODE_SIZE 16
+#define MIN_NODE_SIZE (NODE_SIZE/2)
+#define MAX_HEIGHT 32
+
+#ifdef MAP_STATS
+#define MAP_COUNT(map,counter,amount) \
+        __atomic_add_fetch(&(map)->stats.counter,(amount),__ATOMIC_RELAXED)
+#else
+#define MAP_COUNT(map,counter,amount) ((void)0)
+#endif
 
 typedef struct Node_t* Node;
 
+/**
+ * The map is a B+tree. All the pairs are kept in the leaves, in increasing
+ * key order inside each leaf and from a leaf to the next one, so iterating
+ * the map scans the key arrays of the leaves one after the other. In a branch
+ * values[i] is the i-th child, keys[i] is the smallest key under it and
+ * counts[i] is the number of pairs under it. Every node but the root points
+ * to its parent branch.
+ */
 struct Node_t
 {
-    MapDataElement data;
-    MapKeyElement key;
+    MapKeyElement keys[NODE_SIZE];
+    void* values[NODE_SIZE];
+    int counts[NODE_SIZE];
+    int size;
     Node next;
     Node prev;
+    Node parent;
 };
 
 struct Map_t
@@ -23,35 +47,251 @@ struct Map_t
     freeMapKeyElements free_key;
     freeMapDataElements free_data;
     compareMapKeyElements cmp_key;
+    Node root;
+    int height;
+    Node first;
+    Node last;
     Node current;
+    int current_index;
     int size;
-    Node head;
-    Node tail;
+    unsigned int version;
+    MapStats stats;
 };
 
 /**
- * This function gets a map with iterator(current) pointing to the node that
- * we want to remove from the map, removes in then connects the previous and
- * the next nodes, then updates the size of the map.
+ * this function allocates an empty node.
+ *
+ * @return :
+ * NULL if the allocation fails
+ * the new node otherwise
+ */
+static Node nodeCreate();
+
+/**
+ * this function compares two keys with the key compare function of the map,
+ * and counts the comparison.
+ *
+ * @param map
+ * @param first
+ * @param second
+ * @return :
+ * the result of the key compare function
+ */
+static int compareKeys(Map map, MapKeyElement first, MapKeyElement second);
+
+/**
+ * this function finds the child of a branch whose keys range holds the key,
+ * the last child whose smallest key is not larger than the key, or the first
+ * child if there is none.
+ *
+ * @param map
+ * @param branch
+ * @param keyElement
+ * @return :
+ * the index of the child
+ */
+static int branchIndex(Map map, Node branch, MapKeyElement keyElement);
+
+/**
+ * this function finds the index of the first key in a leaf which is not
+ * smaller than the given key. The last key is compared first so putting an
+ * increasing key takes one comparison.
+ *
+ * @param map
+ * @param leaf
+ * @param keyElement
+ * @param found - set to whether the key at the index equals the given key
+ * @return :
+ * the index of the key
+ */
+static int leafIndex(Map map, Node leaf, MapKeyElement keyElement,
+                     bool* found);
+
+/**
+ * this function returns the leaf whose keys range holds the given key.
+ *
+ * @param map
+ * @param keyElement
+ * @return :
+ * the leaf of the key
+ */
+static Node findLeaf(Map map, MapKeyElement keyElement);
+
+/**
+ * this function puts a key in the map, inside the given leaf if the key
+ * belongs to it and it has room, otherwise from the root of the map.
+ *
+ * @param map
+ * @param leaf - a leaf of the map
+ * @param keyElement
+ * @param dataElement
+ * @param put - set to the leaf holding the key on success
+ * @return :
+ * MAP_OUT_OF_MEMORY if an allocation fails, the map is left unchanged
+ * MAP_SUCCESS if the key was put successfully
+ */
+static MapResult putNear(Map map, Node leaf, MapKeyElement keyElement,
+                         MapDataElement dataElement, Node* put);
+
+/**
+ * this function puts a key in the map searching from the root, full nodes on
+ * the way are split from the leaf up. All the nodes the split needs are
+ * allocated before the tree is changed.
+ *
+ * @param map
+ * @param keyElement
+ * @param dataElement
+ * @param put - set to the leaf holding the key on success
+ * @return :
+ * MAP_OUT_OF_MEMORY if an allocation fails, the map is left unchanged
+ * MAP_SUCCESS if the key was put successfully
+ */
+static MapResult putFromRoot(Map map, MapKeyElement keyElement,
+                             MapDataElement dataElement, Node* put);
+
+/**
+ * this function inserts a key and value into a node which is not full.
+ *
+ * @param node
+ * @param index - the place of the new key
+ * @param keyElement
+ * @param value
+ * @param count - the number of pairs under value if node is a branch
+ */
+static void nodeInsert(Node node, int index, MapKeyElement keyElement,
+                       void* value, int count);
+
+/**
+ * this function removes the key and value at the index from a node.
+ *
+ * @param node
+ * @param index
+ */
+static void nodeErase(Node node, int index);
+
+/**
+ * this function inserts a key and value into a full node by moving the upper
+ * part of its keys to an empty right node. When a key is appended to the last
+ * leaf the right node gets only the new key, so leaves filled in increasing
+ * order stay full.
  *
  * @param map
+ * @param node
+ * @param right - an empty node
+ * @param index - the place of the new key
+ * @param keyElement
+ * @param value
+ * @param count - the number of pairs under value if node is a branch
+ * @param leaf - whether node is a leaf
+ * @return :
+ * the node holding the new key
+ */
+static Node nodeSplit(Map map, Node node, Node right, int index,
+                      MapKeyElement keyElement, void* value, int count,
+                      bool leaf);
+
+/**
+ * this function returns the number of pairs under a node.
+ *
+ * @param node
+ * @param leaf - whether node is a leaf
+ * @return :
+ * the number of pairs
  */
-static void nodeDestroy(Map map);
+static int nodeCount(Node node, bool leaf);
 
 /**
- * this function gets a map with iterator(current) pointing to the node, which
- * we want to add the new node next to it, also gets the key and data
- * associated to the new node.
+ * this function sets all the children of a branch to point to it.
+ *
+ * @param branch
+ */
+static void adoptChildren(Node branch);
+
+/**
+ * this function adds to the pairs counts of all the branches above a node.
+ *
+ * @param node
+ * @param amount
+ */
+static void addToCounts(Node node, int amount);
+
+/**
+ * this function removes a key from the subtree of a node, children left with
+ * less than MIN_NODE_SIZE keys borrow from a sibling or merge with it.
  *
  * @param map
+ * @param node
+ * @param depth - the depth of the node, the root is at 0
  * @param keyElement
+ * @return :
+ * MAP_ITEM_DOES_NOT_EXIST if the key is not in the subtree
+ * MAP_SUCCESS if the key was removed successfully
+ */
+static MapResult removeFrom(Map map, Node node, int depth,
+                            MapKeyElement keyElement);
+
+/**
+ * this function refills a child of a branch which has too few keys, by
+ * borrowing a key from a sibling with keys to spare or else by merging it
+ * with a sibling.
+ *
+ * @param map
+ * @param branch
+ * @param index - the index of the child
+ * @param leaf - whether the child is a leaf
+ */
+static void fixChild(Map map, Node branch, int index, bool leaf);
+
+/**
+ * this function frees all the nodes and elements in the subtree of a node,
+ * except the node to keep.
+ *
+ * @param map
+ * @param node
+ * @param depth - the depth of the node, the root is at 0
+ * @param keep - a leaf which is emptied but not freed
+ */
+static void clearNode(Map map, Node node, int depth, Node keep);
+
+/**
+ * this function returns a version number no map had before, a map takes a
+ * new version whenever a leaf is freed so old position hints (even ones of a
+ * destroyed map at the same address) are never trusted.
+ *
+ * @return :
+ * a new version number
+ */
+static unsigned int newVersion();
+
+/**
+ * this function replaces the data at the index of a leaf by a copy of the
+ * given data.
+ *
+ * @param map
+ * @param leaf
+ * @param index
  * @param dataElement
  * @return :
+ * MAP_OUT_OF_MEMORY if an allocation fails, the old data is kept
+ * MAP_SUCCESS if the data was replaced successfully
+ */
+static MapResult replaceData(Map map, Node leaf, int index,
+                             MapDataElement dataElement);
+
+/**
+ * this function fills order with the indexes of the given keys sorted by the
+ * key compare function, equal keys keep their order (a stable merge sort).
+ *
+ * @param map
+ * @param keyElements
+ * @param size
+ * @param order - room for size indexes
+ * @return :
  * MAP_OUT_OF_MEMORY if an allocation fails
- * MAP_SUCCESS if the node was added successfully
+ * MAP_SUCCESS if the keys were sorted successfully
  */
-static MapResult createNode(Map map, MapKeyElement keyElement,
-                            MapDataElement dataElement);
+static MapResult sortPairs(Map map, MapKeyElement* keyElements, int size,
+                           int* order);
 
 Map mapCreate(copyMapDataElements copyDataElement,
               copyMapKeyElements copyKeyElement,
@@ -64,37 +304,30 @@ Map mapCreate(copyMapDataElements copyDataElement,
     {
         return NULL;
     }
-    Map map=malloc(sizeof(*map));
+    Map map=memstatMalloc(MEMSTAT_MAP,sizeof(*map));
     if(!map)
     {
         return NULL;
     }
-    map->head=NULL;
-    map->tail=NULL;
     map->copy_key=copyKeyElement;
     map->copy_data=copyDataElement;
     map->free_key=freeKeyElement;
     map->free_data=freeDataElement;
     map->cmp_key=compareKeyElements;
-    map->head=malloc(sizeof(*(map->head)));
-    map->tail=malloc(sizeof(*(map->tail)));
-    if(!(map->tail) || !(map->head))
+    map->root=nodeCreate();
+    if(!(map->root))
     {
-        free(map->tail);
-        free(map->head);
-        free(map);
+        memstatFree(map);
         return NULL;
     }
-    map->tail->key=NULL;
-    map->tail->data=NULL;
-    map->head->key=NULL;
-    map->head->data=NULL;
-    map->head->next=map->tail;
-    map->head->prev=NULL;
-    map->tail->next=NULL;
-    map->tail->prev=map->head;
-    map->current=map->head;
+    map->height=0;
+    map->first=map->root;
+    map->last=map->root;
+    map->current=NULL;
+    map->current_index=0;
     map->size=0;
+    map->version=newVersion();
+    mapResetStats(map);
     return map;
 }
 
@@ -105,9 +338,8 @@ void mapDestroy(Map map)
         return;
     }
     mapClear(map);
-    free(map->head);
-    free(map->tail);
-    free(map);
+    memstatFree(map->root);
+    memstatFree(map);
 }
 
 Map mapCopy(Map map)
@@ -122,51 +354,82 @@ Map mapCopy(Map map)
     {
         return NULL;
     }
-    if(!map->size)
+    Node put;
+    for(Node leaf=map->first;leaf;leaf=leaf->next)
     {
-        return new_map;
+        for(int i=0;i<leaf->size;i++)
+        {
+            if(putNear(new_map,new_map->last,leaf->keys[i],leaf->values[i],
+                       &put)!=MAP_SUCCESS)
+            {
+                mapDestroy(new_map);
+                return NULL;
+            }
+        }
     }
-    new_map->current=malloc(sizeof(*(new_map->current)));
-    if(!(new_map->current))
+    return new_map;
+}
+
+Map mapCreateFromSorted(copyMapDataElements copyDataElement,
+                        copyMapKeyElements copyKeyElement,
+                        freeMapDataElements freeDataElement,
+                        freeMapKeyElements freeKeyElement,
+                        compareMapKeyElements compareKeyElements,
+                        MapKeyElement* keyElements,
+                        MapDataElement* dataElements, int size)
+{
+    Map map=mapCreate(copyDataElement,copyKeyElement,freeDataElement,
+                      freeKeyElement,compareKeyElements);
+    if(!map)
+    {
+        return NULL;
+    }
+    if(mapPutAll(map,keyElements,dataElements,size)!=MAP_SUCCESS)
     {
-        mapDestroy(new_map);
+        mapDestroy(map);
         return NULL;
     }
-    map->current=map->head->next;
-    new_map->head->next=new_map->current;
-    new_map->current->prev=new_map->head;
-    new_map->current->key=(map->copy_key)(map->current->key);
-    new_map->current->data=(map->copy_data)(map->current->data);
-    map->current=map->current->next;
-    if(!new_map->current->key || !new_map->current->data)
+    return map;
+}
+
+MapResult mapPutAll(Map map, MapKeyElement* keyElements,
+                    MapDataElement* dataElements, int size)
+{
+    if(!map || ((!keyElements || !dataElements) && size>0))
     {
-        mapDestroy(new_map);
-        return  NULL;
+        return MAP_NULL_ARGUMENT;
     }
-    while(map->current!=map->tail)
+    for(int i=0;i<size;i++)
     {
-        Node tmp=new_map->current;
-        new_map->current=malloc(sizeof(*(new_map->current)));
-        if(!(new_map->current))
+        if(!keyElements[i] || !dataElements[i])
         {
-            mapDestroy(new_map);
-            return NULL;
+            return MAP_NULL_ARGUMENT;
         }
-        new_map->current->prev=tmp;
-        tmp->next=new_map->current;
-        new_map->current->key=(map->copy_key)(map->current->key);
-        new_map->current->data=(map->copy_data)(map->current->data);
-        if(!new_map->current->key || !new_map->current->data)
+    }
+    int* order=NULL;
+    for(int i=1;i<size;i++)
+    {
+        if(compareKeys(map,keyElements[i-1],keyElements[i])>0)
         {
-            mapDestroy(new_map);
-            return  NULL;
+            order=memstatMalloc(MEMSTAT_MAP,sizeof(*order)*size);
+            if(!order || sortPairs(map,keyElements,size,order)!=MAP_SUCCESS)
+            {
+                memstatFree(order);
+                return MAP_OUT_OF_MEMORY;
+            }
+            break;
         }
-        map->current=map->current->next;
     }
-    new_map->current->next=new_map->tail;
-    new_map->tail->prev=new_map->current;
-    new_map->size=map->size;
-    return new_map;
+    MapHint hint=MAP_HINT_INIT;
+    MapResult result=MAP_SUCCESS;
+    int index;
+    for(int i=0;i<size && result==MAP_SUCCESS;i++)
+    {
+        index=order ? order[i] : i;
+        result=mapPutHint(map,&hint,keyElements[index],dataElements[index]);
+    }
+    memstatFree(order);
+    return result;
 }
 
 int mapGetSize(Map map)
@@ -184,102 +447,396 @@ bool mapContains(Map map, MapKeyElement element)
     {
         return false;
     }
-    map->current=map->head->next;
-    while(map->current!=map->tail)
+    MAP_COUNT(map,operations,1);
+    bool found;
+    leafIndex(map,findLeaf(map,element),element,&found);
+    return found;
+}
+
+MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if(!map || !keyElement || !dataElement)
     {
-        if(!(map->cmp_key)(map->current->key ,element))
-        {
-            return true;
-        }
-        map->current=map->current->next;
+        return MAP_NULL_ARGUMENT;
     }
-    return false;
+    Node put;
+    return putNear(map,map->last,keyElement,dataElement,&put);
 }
 
-MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+MapResult mapPutHint(Map map, MapHint* hint, MapKeyElement keyElement,
+                     MapDataElement dataElement)
 {
+    if(!hint)
+    {
+        return mapPut(map,keyElement,dataElement);
+    }
     if(!map || !keyElement || !dataElement)
     {
         return MAP_NULL_ARGUMENT;
     }
-    map->current=map->head;
-    if(!map->size)
+    Node start=map->last, put;
+    if(hint->map==map && hint->position && hint->version==map->version)
+    {
+        start=hint->position;
+    }
+    MapResult result=putNear(map,start,keyElement,dataElement,&put);
+    if(result==MAP_SUCCESS)
+    {
+        hint->map=map;
+        hint->position=put;
+        hint->version=map->version;
+    }
+    return result;
+}
+
+static MapResult putNear(Map map, Node leaf, MapKeyElement keyElement,
+                         MapDataElement dataElement, Node* put)
+{
+    MAP_COUNT(map,operations,1);
+    MAP_COUNT(map,nodes_visited,1);
+    if(leaf->size==0 || compareKeys(map,leaf->keys[0],keyElement)>0 ||
+       (leaf->next && compareKeys(map,keyElement,leaf->next->keys[0])>=0))
+    {
+        return putFromRoot(map,keyElement,dataElement,put);
+    }
+    bool found;
+    int index=leafIndex(map,leaf,keyElement,&found);
+    if(found)
     {
-        return createNode(map,keyElement,dataElement);
+        *put=leaf;
+        return replaceData(map,leaf,index,dataElement);
     }
-    if((map->cmp_key)(map->head->next->key,keyElement)>0)
+    if(leaf->size==NODE_SIZE)
     {
-        return createNode(map,keyElement,dataElement);
+        return putFromRoot(map,keyElement,dataElement,put);
     }
-    if((map->cmp_key)(map->tail->prev->key,keyElement)<0)
+    MapKeyElement key=map->copy_key(keyElement);
+    MapDataElement data=map->copy_data(dataElement);
+    MAP_COUNT(map,key_copies,1);
+    MAP_COUNT(map,data_copies,1);
+    if(!key || !data)
     {
-        map->current=map->tail->prev;
-        return createNode(map,keyElement,dataElement);
+        map->free_key(key);
+        map->free_data(data);
+        return MAP_OUT_OF_MEMORY;
     }
-    map->current=map->head->next;
-    while(map->current!=map->tail->prev)
+    nodeInsert(leaf,index,key,data,0);
+    addToCounts(leaf,1);
+    (map->size)++;
+    MAP_COUNT(map,inserts,1);
+    map->current=NULL;
+    *put=leaf;
+    return MAP_SUCCESS;
+}
+
+static MapResult putFromRoot(Map map, MapKeyElement keyElement,
+                             MapDataElement dataElement, Node* put)
+{
+    Node path[MAX_HEIGHT];
+    int indexes[MAX_HEIGHT];
+    Node node=map->root;
+    for(int depth=0;depth<map->height;depth++)
+    {
+        path[depth]=node;
+        indexes[depth]=branchIndex(map,node,keyElement);
+        node=node->values[indexes[depth]];
+    }
+    MAP_COUNT(map,nodes_visited,map->height+1);
+    bool found;
+    int index=leafIndex(map,node,keyElement,&found);
+    if(found)
     {
-        if(map->cmp_key(map->current->key,keyElement)==0)
+        *put=node;
+        return replaceData(map,node,index,dataElement);
+    }
+    int splits=0;
+    if(node->size==NODE_SIZE)
+    {
+        splits=1;
+        while(splits<=map->height &&
+              path[map->height-splits]->size==NODE_SIZE)
         {
-            map->free_data(map->current->data);
-            map->current->data=map->copy_data(dataElement);
-            if(!map->current->data)
-            {
-                return MAP_OUT_OF_MEMORY;
-            }
+            splits++;
         }
-        if((map->cmp_key(map->current->key,keyElement)<0 &&
-           map->cmp_key(map->current->next->key,keyElement)>0))
+        if(splits>map->height)
         {
-            return createNode(map,keyElement,dataElement);
+            splits++;
         }
-        map->current=map->current->next;
+    }
+    Node new_nodes[MAX_HEIGHT+2];
+    bool failed=false;
+    for(int i=0;i<splits;i++)
+    {
+        new_nodes[i]=nodeCreate();
+        failed=failed || !new_nodes[i];
+    }
+    MapKeyElement key=map->copy_key(keyElement);
+    MapDataElement data=map->copy_data(dataElement);
+    MAP_COUNT(map,key_copies,1);
+    MAP_COUNT(map,data_copies,1);
+    if(failed || !key || !data)
+    {
+        for(int i=0;i<splits;i++)
+        {
+            memstatFree(new_nodes[i]);
+        }
+        map->free_key(key);
+        map->free_data(data);
+        return MAP_OUT_OF_MEMORY;
+    }
+    (map->size)++;
+    MAP_COUNT(map,inserts,1);
+    map->current=NULL;
+    if(node->size<NODE_SIZE)
+    {
+        nodeInsert(node,index,key,data,0);
+        *put=node;
+    }
+    else
+    {
+        *put=nodeSplit(map,node,new_nodes[0],index,key,data,0,true);
+    }
+    Node split=splits ? new_nodes[0] : NULL;
+    int used=1;
+    for(int depth=map->height-1;depth>=0;depth--)
+    {
+        Node branch=path[depth];
+        int child=indexes[depth];
+        bool leaf=depth+1==map->height;
+        branch->keys[child]=((Node)branch->values[child])->keys[0];
+        branch->counts[child]=nodeCount(branch->values[child],leaf);
+        if(!split)
+        {
+            continue;
+        }
+        if(branch->size<NODE_SIZE)
+        {
+            nodeInsert(branch,child+1,split->keys[0],split,
+                       nodeCount(split,leaf));
+            split->parent=branch;
+            split=NULL;
+        }
+        else
+        {
+            nodeSplit(map,branch,new_nodes[used],child+1,split->keys[0],
+                      split,nodeCount(split,leaf),false);
+            adoptChildren(branch);
+            adoptChildren(new_nodes[used]);
+            split=new_nodes[used++];
+        }
+    }
+    if(split)
+    {
+        Node root=new_nodes[used];
+        bool leaf=map->height==0;
+        nodeInsert(root,0,map->root->keys[0],map->root,
+                   nodeCount(map->root,leaf));
+        nodeInsert(root,1,split->keys[0],split,nodeCount(split,leaf));
+        adoptChildren(root);
+        map->root=root;
+        (map->height)++;
     }
     return MAP_SUCCESS;
 }
 
-static MapResult createNode(Map map, MapKeyElement keyElement
-        , MapDataElement dataElement)
+static Node nodeCreate()
 {
-    Node tmp=malloc(sizeof(*tmp));
-    if(!tmp)
+    Node node=memstatMalloc(MEMSTAT_MAP,sizeof(*node));
+    if(!node)
     {
-        return MAP_OUT_OF_MEMORY;
+        return NULL;
     }
-    tmp->next=map->current->next;
-    tmp->prev=map->current;
-    map->current->next->prev=tmp;
-    map->current->next=tmp;
-    tmp->key=map->copy_key(keyElement);
-    tmp->data=map->copy_data(dataElement);
-    if(!(tmp->key) || !(tmp->data) )
-    {
-        map->free_key(tmp->key);
-        map->free_data(tmp->data);
-        free(tmp);
-        return MAP_OUT_OF_MEMORY;
+    node->size=0;
+    node->next=NULL;
+    node->prev=NULL;
+    node->parent=NULL;
+    return node;
+}
+
+static int compareKeys(Map map, MapKeyElement first, MapKeyElement second)
+{
+    MAP_COUNT(map,comparisons,1);
+    return map->cmp_key(first,second);
+}
+
+static int branchIndex(Map map, Node branch, MapKeyElement keyElement)
+{
+    int low=1, high=branch->size, middle;
+    while(low<high)
+    {
+        middle=low+(high-low)/2;
+        if(compareKeys(map,branch->keys[middle],keyElement)<=0)
+        {
+            low=middle+1;
+        }
+        else
+        {
+            high=middle;
+        }
     }
-    map->size++;
-    return MAP_SUCCESS;
+    return low-1;
 }
 
-MapDataElement mapGet(Map map, MapKeyElement keyElement)
+static int leafIndex(Map map, Node leaf, MapKeyElement keyElement,
+                     bool* found)
 {
-    if(!map || !keyElement)
+    *found=false;
+    if(leaf->size==0)
     {
-        return NULL;
+        return 0;
     }
-    Node tmp=NULL;
-    tmp=map->head->next;
-    while(tmp!=map->tail)
+    int cmp=compareKeys(map,leaf->keys[leaf->size-1],keyElement);
+    if(cmp<=0)
     {
-        if(map->cmp_key(tmp->key,keyElement)==0)
+        *found=cmp==0;
+        return cmp==0 ? leaf->size-1 : leaf->size;
+    }
+    int low=0, high=leaf->size-1, middle;
+    while(low<high)
+    {
+        middle=low+(high-low)/2;
+        cmp=compareKeys(map,leaf->keys[middle],keyElement);
+        if(cmp==0)
+        {
+            *found=true;
+            return middle;
+        }
+        if(cmp<0)
+        {
+            low=middle+1;
+        }
+        else
         {
-            return tmp->data;
+            high=middle;
         }
-        tmp=tmp->next;
     }
-    return NULL;
+    return low;
+}
+
+static Node findLeaf(Map map, MapKeyElement keyElement)
+{
+    MAP_COUNT(map,nodes_visited,map->height+1);
+    Node node=map->root;
+    for(int depth=0;depth<map->height;depth++)
+    {
+        node=node->values[branchIndex(map,node,keyElement)];
+    }
+    return node;
+}
+
+static void nodeInsert(Node node, int index, MapKeyElement keyElement,
+                       void* value, int count)
+{
+    memmove(node->keys+index+1,node->keys+index,
+            sizeof(*(node->keys))*(node->size-index));
+    memmove(node->values+index+1,node->values+index,
+            sizeof(*(node->values))*(node->size-index));
+    memmove(node->counts+index+1,node->counts+index,
+            sizeof(*(node->counts))*(node->size-index));
+    node->keys[index]=keyElement;
+    node->values[index]=value;
+    node->counts[index]=count;
+    (node->size)++;
+}
+
+static void nodeErase(Node node, int index)
+{
+    (node->size)--;
+    memmove(node->keys+index,node->keys+index+1,
+            sizeof(*(node->keys))*(node->size-index));
+    memmove(node->values+index,node->values+index+1,
+            sizeof(*(node->values))*(node->size-index));
+    memmove(node->counts+index,node->counts+index+1,
+            sizeof(*(node->counts))*(node->size-index));
+}
+
+static int nodeCount(Node node, bool leaf)
+{
+    if(leaf)
+    {
+        return node->size;
+    }
+    int count=0;
+    for(int i=0;i<node->size;i++)
+    {
+        count+=node->counts[i];
+    }
+    return count;
+}
+
+static void adoptChildren(Node branch)
+{
+    for(int i=0;i<branch->size;i++)
+    {
+        ((Node)branch->values[i])->parent=branch;
+    }
+}
+
+static void addToCounts(Node node, int amount)
+{
+    int index;
+    for(Node parent=node->parent;parent;parent=parent->parent)
+    {
+        index=parent->size-1;
+        while(parent->values[index]!=node)
+        {
+            index--;
+        }
+        parent->counts[index]+=amount;
+        node=parent;
+    }
+}
+
+static Node nodeSplit(Map map, Node node, Node right, int index,
+                      MapKeyElement keyElement, void* value, int count,
+                      bool leaf)
+{
+    int keep=(NODE_SIZE+1)/2;
+    if(leaf && index==NODE_SIZE && !node->next)
+    {
+        keep=NODE_SIZE;
+    }
+    Node target=node;
+    if(index>=keep)
+    {
+        target=right;
+    }
+    int moved=NODE_SIZE-keep;
+    memcpy(right->keys,node->keys+keep,sizeof(*(node->keys))*moved);
+    memcpy(right->values,node->values+keep,sizeof(*(node->values))*moved);
+    memcpy(right->counts,node->counts+keep,sizeof(*(node->counts))*moved);
+    right->size=moved;
+    node->size=keep;
+    nodeInsert(target,target==right ? index-keep : index,keyElement,value,
+               count);
+    if(leaf)
+    {
+        right->next=node->next;
+        right->prev=node;
+        if(node->next)
+        {
+            node->next->prev=right;
+        }
+        else
+        {
+            map->last=right;
+        }
+        node->next=right;
+    }
+    return target;
+}
+
+MapDataElement mapGet(Map map, MapKeyElement keyElement)
+{
+    if(!map || !keyElement)
+    {
+        return NULL;
+    }
+    MAP_COUNT(map,operations,1);
+    Node leaf=findLeaf(map,keyElement);
+    bool found;
+    int index=leafIndex(map,leaf,keyElement,&found);
+    return found ? leaf->values[index] : NULL;
 }
 
 MapResult mapRemove(Map map, MapKeyElement keyElement)
@@ -288,17 +845,130 @@ MapResult mapRemove(Map map, MapKeyElement keyElement)
     {
         return MAP_NULL_ARGUMENT;
     }
-    map->current=map->head->next;
-    while(map->current!=map->tail)
+    MAP_COUNT(map,operations,1);
+    MapResult result=removeFrom(map,map->root,0,keyElement);
+    if(result!=MAP_SUCCESS)
+    {
+        return result;
+    }
+    map->current=NULL;
+    if(map->height>0 && map->root->size==1)
+    {
+        Node root=map->root;
+        map->root=root->values[0];
+        map->root->parent=NULL;
+        (map->height)--;
+        memstatFree(root);
+    }
+    return MAP_SUCCESS;
+}
+
+static MapResult removeFrom(Map map, Node node, int depth,
+                            MapKeyElement keyElement)
+{
+    MAP_COUNT(map,nodes_visited,1);
+    if(depth==map->height)
     {
-        if(map->cmp_key(map->current->key,keyElement)==0)
+        bool found;
+        int index=leafIndex(map,node,keyElement,&found);
+        if(!found)
         {
-            nodeDestroy(map);
-            return MAP_SUCCESS;
+            return MAP_ITEM_DOES_NOT_EXIST;
         }
-        map->current=map->current->next;
+        map->free_key(node->keys[index]);
+        map->free_data(node->values[index]);
+        nodeErase(node,index);
+        (map->size)--;
+        MAP_COUNT(map,removals,1);
+        return MAP_SUCCESS;
     }
-    return MAP_ITEM_DOES_NOT_EXIST;
+    int index=branchIndex(map,node,keyElement);
+    Node child=node->values[index];
+    MapResult result=removeFrom(map,child,depth+1,keyElement);
+    if(result!=MAP_SUCCESS)
+    {
+        return result;
+    }
+    (node->counts[index])--;
+    if(child->size>0)
+    {
+        node->keys[index]=child->keys[0];
+    }
+    if(child->size<MIN_NODE_SIZE)
+    {
+        fixChild(map,node,index,depth+1==map->height);
+    }
+    return MAP_SUCCESS;
+}
+
+static void fixChild(Map map, Node branch, int index, bool leaf)
+{
+    Node child=branch->values[index];
+    Node left=index>0 ? branch->values[index-1] : NULL;
+    Node right=index+1<branch->size ? branch->values[index+1] : NULL;
+    if(left && left->size>MIN_NODE_SIZE)
+    {
+        nodeInsert(child,0,left->keys[left->size-1],
+                   left->values[left->size-1],left->counts[left->size-1]);
+        (left->size)--;
+        if(!leaf)
+        {
+            adoptChildren(child);
+        }
+        branch->keys[index]=child->keys[0];
+        branch->counts[index-1]=nodeCount(left,leaf);
+        branch->counts[index]=nodeCount(child,leaf);
+        return;
+    }
+    if(right && right->size>MIN_NODE_SIZE)
+    {
+        nodeInsert(child,child->size,right->keys[0],right->values[0],
+                   right->counts[0]);
+        nodeErase(right,0);
+        if(!leaf)
+        {
+            adoptChildren(child);
+        }
+        branch->keys[index]=child->keys[0];
+        branch->keys[index+1]=right->keys[0];
+        branch->counts[index]=nodeCount(child,leaf);
+        branch->counts[index+1]=nodeCount(right,leaf);
+        return;
+    }
+    if(!left)
+    {
+        left=child;
+        child=right;
+        index++;
+    }
+    memcpy(left->keys+left->size,child->keys,
+           sizeof(*(child->keys))*child->size);
+    memcpy(left->values+left->size,child->values,
+           sizeof(*(child->values))*child->size);
+    memcpy(left->counts+left->size,child->counts,
+           sizeof(*(child->counts))*child->size);
+    left->size+=child->size;
+    if(!leaf)
+    {
+        adoptChildren(left);
+    }
+    else
+    {
+        left->next=child->next;
+        if(child->next)
+        {
+            child->next->prev=left;
+        }
+        else
+        {
+            map->last=left;
+        }
+        map->version=newVersion();
+    }
+    memstatFree(child);
+    nodeErase(branch,index);
+    branch->keys[index-1]=left->keys[0];
+    branch->counts[index-1]=nodeCount(left,leaf);
 }
 
 MapKeyElement mapGetFirst(Map map)
@@ -307,58 +977,255 @@ MapKeyElement mapGetFirst(Map map)
     {
         return NULL;
     }
-    map->current=map->head->next;
-    return map->current->key;
+    map->current=map->first;
+    map->current_index=0;
+    return map->current->keys[0];
 }
 
 MapKeyElement mapGetNext(Map map)
 {
-    if(!map)
+    if(!map || !map->current)
     {
         return NULL;
     }
-    if(map->current==map->head || map->current==map->tail)
+    if(map->current_index+1<map->current->size)
     {
-        return NULL;
+        (map->current_index)++;
+        return map->current->keys[map->current_index];
     }
-    if(map->current->next!=map->tail)
+    if(map->current->next)
     {
         map->current=map->current->next;
-        return map->current->key;
+        map->current_index=0;
+        return map->current->keys[0];
     }
     return NULL;
 }
 
-MapResult mapClear(Map map)
+MapKeyElement mapGetKth(Map map, int k)
 {
+    if(!map || k<0 || k>=map->size)
+    {
+        return NULL;
+    }
+    MAP_COUNT(map,operations,1);
+    MAP_COUNT(map,nodes_visited,map->height+1);
+    Node node=map->root;
+    int child;
+    for(int depth=0;depth<map->height;depth++)
+    {
+        child=0;
+        while(k>=node->counts[child])
+        {
+            k-=node->counts[child];
+            child++;
+        }
+        node=node->values[child];
+    }
+    map->current=node;
+    map->current_index=k;
+    return node->keys[k];
+}
+
+int mapRank(Map map, MapKeyElement keyElement)
+{
+    if(!map || !keyElement)
+    {
+        return ILLEGAL;
+    }
+    MAP_COUNT(map,operations,1);
+    MAP_COUNT(map,nodes_visited,map->height+1);
+    Node node=map->root;
+    int rank=0, child;
+    for(int depth=0;depth<map->height;depth++)
+    {
+        child=branchIndex(map,node,keyElement);
+        for(int i=0;i<child;i++)
+        {
+            rank+=node->counts[i];
+        }
+        node=node->values[child];
+    }
+    bool found;
+    return rank+leafIndex(map,node,keyElement,&found);
+}
+
+int mapRangeForEach(Map map, MapKeyElement lowKey, MapKeyElement highKey,
+                    mapRangeAction action, void* context)
+{
+    if(!map || !lowKey || !highKey || !action)
+    {
+        return ILLEGAL;
+    }
+    MAP_COUNT(map,operations,1);
+    Node leaf=findLeaf(map,lowKey);
+    bool found;
+    int index=leafIndex(map,leaf,lowKey,&found), visited=0;
+    while(leaf)
+    {
+        for(;index<leaf->size;index++)
+        {
+            if(compareKeys(map,leaf->keys[index],highKey)>0)
+            {
+                return visited;
+            }
+            action(leaf->keys[index],leaf->values[index],context);
+            visited++;
+        }
+        leaf=leaf->next;
+        index=0;
+        if(leaf)
+        {
+            MAP_COUNT(map,nodes_visited,1);
+        }
+    }
+    return visited;
+}
+
+MapStats mapGetStats(Map map)
+{
+    MapStats stats={0,0,0,0,0,0,0};
     if(!map)
     {
-        return MAP_NULL_ARGUMENT;
+        return stats;
     }
-    map->current=map->head->next;
-    Node tmp=NULL;
-    while((map->current) != (map->tail))
+    stats.operations=__atomic_load_n(&map->stats.operations,
+                                     __ATOMIC_RELAXED);
+    stats.comparisons=__atomic_load_n(&map->stats.comparisons,
+                                      __ATOMIC_RELAXED);
+    stats.nodes_visited=__atomic_load_n(&map->stats.nodes_visited,
+                                        __ATOMIC_RELAXED);
+    stats.inserts=__atomic_load_n(&map->stats.inserts,__ATOMIC_RELAXED);
+    stats.removals=__atomic_load_n(&map->stats.removals,__ATOMIC_RELAXED);
+    stats.key_copies=__atomic_load_n(&map->stats.key_copies,
+                                     __ATOMIC_RELAXED);
+    stats.data_copies=__atomic_load_n(&map->stats.data_copies,
+                                      __ATOMIC_RELAXED);
+    return stats;
+}
+
+void mapResetStats(Map map)
+{
+    if(!map)
     {
-        tmp=map->current->next;
-        nodeDestroy(map);
-        map->current=tmp;
+        return;
     }
-    map->head->next=map->tail;
-    map->tail->prev=map->head;
-    map->current=map->head;
-    return MAP_SUCCESS;
+    MapStats* stats=&map->stats;
+    __atomic_store_n(&stats->operations,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats->comparisons,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats->nodes_visited,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats->inserts,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats->removals,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats->key_copies,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats->data_copies,0,__ATOMIC_RELAXED);
 }
 
-static void nodeDestroy(Map map)
+MapResult mapClear(Map map)
 {
-    map->free_key(map->current->key);
-    map->free_data(map->current->data);
-    map->current->prev->next=map->current->next;
-    map->current->next->prev=map->current->prev;
-    free(map->current);
-    (map->size)--;
+    if(!map)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    MAP_COUNT(map,removals,map->size);
+    clearNode(map,map->root,0,map->first);
+    map->root=map->first;
+    map->root->size=0;
+    map->root->next=NULL;
+    map->root->prev=NULL;
+    map->root->parent=NULL;
+    map->height=0;
+    map->last=map->root;
+    map->current=NULL;
+    map->size=0;
+    map->version=newVersion();
+    return MAP_SUCCESS;
 }
 
+static void clearNode(Map map, Node node, int depth, Node keep)
+{
+    for(int i=0;i<node->size;i++)
+    {
+        if(depth==map->height)
+        {
+            map->free_key(node->keys[i]);
+            map->free_data(node->values[i]);
+        }
+        else
+        {
+            clearNode(map,node->values[i],depth+1,keep);
+        }
+    }
+    if(node!=keep)
+    {
+        memstatFree(node);
+    }
+}
 
+static unsigned int newVersion()
+{
+    static unsigned int last_version=0;
+    return __atomic_add_fetch(&last_version,1,__ATOMIC_RELAXED);
+}
 
+static MapResult replaceData(Map map, Node leaf, int index,
+                             MapDataElement dataElement)
+{
+    MapDataElement data=map->copy_data(dataElement);
+    MAP_COUNT(map,data_copies,1);
+    if(!data)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    map->free_data(leaf->values[index]);
+    leaf->values[index]=data;
+    return MAP_SUCCESS;
+}
 
+static MapResult sortPairs(Map map, MapKeyElement* keyElements, int size,
+                           int* order)
+{
+    for(int i=0;i<size;i++)
+    {
+        order[i]=i;
+    }
+    int* tmp=memstatMalloc(MEMSTAT_MAP,sizeof(*tmp)*size);
+    if(!tmp)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    for(int width=1;width<size;width*=2)
+    {
+        for(int low=0;low<size-width;low+=2*width)
+        {
+            int middle=low+width;
+            int high=middle+width < size ? middle+width : size;
+            int left=low, right=middle, out=low;
+            while(left<middle && right<high)
+            {
+                if(compareKeys(map,keyElements[order[right]],
+                               keyElements[order[left]])<0)
+                {
+                    tmp[out++]=order[right++];
+                }
+                else
+                {
+                    tmp[out++]=order[left++];
+                }
+            }
+            while(left<middle)
+            {
+                tmp[out++]=order[left++];
+            }
+            while(right<high)
+            {
+                tmp[out++]=order[right++];
+            }
+            for(int i=low;i<high;i++)
+            {
+                order[i]=tmp[i];
+            }
+        }
+    }
+    memstatFree(tmp);
+    return MAP_SUCCESS;
+}
@@ -7,6 +7,8 @@
 * Generic Map Container
 *
 * Implements a map container type.
+* The map is kept as a B+tree ordered by the key compare function, lookups
+* take O(log n) and iterating goes over the keys in increasing order.
 * The map has an internal iterator for external use. For all functions
 * where the state of the iterator after calling that function is not stated,
 * it is undefined. That is you cannot assume anything about it.
@@ -14,15 +16,21 @@
 * The following functions are available:
 *   mapCreate		- Creates a new empty map
 *   mapDestroy		- Deletes an existing map and frees all resources
+*   mapCreateFromSorted - Creates a new map from arrays of key and data pairs
 *   mapCopy		- Copies an existing map
 *   mapGetSize		- Returns the size of a given map
 *   mapContains	- returns weather or not a key exists inside the map.
-*   				  This resets the internal iterator.
+*   				  Iterator status unchanged
 *   mapPut		    - Gives a specific key a given value.
 *   				  If the key exists, the value is overridden.
 *   				  This resets the internal iterator.
+*   mapPutHint		- Puts a key in the map starting the search from a position
+*   				  hint, putting increasing keys takes O(1) each.
+*   				  This resets the internal iterator.
 *   mapGet  	    - Returns the data paired to a key which matches the given key.
 *					  Iterator status unchanged
+*   mapPutAll		- Puts arrays of key and data pairs in the map in one pass.
+*   				  This resets the internal iterator.
 *   mapRemove		- Removes a pair of (key,data) elements for which the key
 *                    matches a given element (by the key compare function).
 *   				  This resets the internal iterator.
@@ -30,6 +38,13 @@
 *   				  map, and returns it.
 *   mapGetNext		- Advances the internal iterator to the next key and
 *   				  returns it.
+*   mapGetKth		- Sets the internal iterator to the key with k smaller
+*   				  keys, and returns it.
+*   mapRank		- Returns the number of keys smaller than a given key.
+*   mapRangeForEach	- Calls a function for every pair with a key inside a
+*   				  given range, in increasing key order.
+*   mapGetStats		- Returns the operation counters of the map.
+*   mapResetStats	- Zeroes the operation counters of the map.
 *	 mapClear		- Clears the contents of the map. Frees all the elements of
 *	 				  the map using the free function.
 * 	 MAP_FOREACH	- A macro for iterating over the map's elements.
@@ -47,6 +62,40 @@ typedef enum MapResult_t {
     MAP_ITEM_DOES_NOT_EXIST
 } MapResult;
 
+/**
+* Position hint for mapPutHint, remembers where the last key was put so the
+* next key put near it is found without searching from the start of the map.
+* Initialize with MAP_HINT_INIT, the fields are internal to the map.
+*/
+typedef struct MapHint_t {
+    Map map;
+    void *position;
+    unsigned int version;
+} MapHint;
+
+/**
+* Operation counters of a map, kept only when the map is compiled with
+* -DMAP_STATS and all zero otherwise. comparisons and nodes_visited divided by
+* operations give the average cost of one search.
+*/
+typedef struct MapStats_t {
+    /* puts, gets, removes, contains, ranks, kth and range lookups */
+    long operations;
+    /* calls of the key compare function */
+    long comparisons;
+    /* tree nodes the searches went through, the leaves included */
+    long nodes_visited;
+    /* pairs added by a put of a new key */
+    long inserts;
+    /* pairs removed by mapRemove or mapClear */
+    long removals;
+    /* calls of the key and data copy functions */
+    long key_copies;
+    long data_copies;
+} MapStats;
+
+#define MAP_HINT_INIT {NULL, NULL, 0}
+
 /** Data element data type for map container */
 typedef void *MapDataElement;
 
@@ -65,6 +114,10 @@ typedef void(*freeMapDataElements)(MapDataElement);
 /** Type of function for deallocating a key element of the map */
 typedef void(*freeMapKeyElements)(MapKeyElement);
 
+/** Type of function called by mapRangeForEach with each key, its data and
+* the context given to mapRangeForEach */
+typedef void(*mapRangeAction)(MapKeyElement, MapDataElement, void*);
+
 
 /**
 * Type of function used by the map to identify equal key elements.
@@ -98,6 +151,29 @@ Map mapCreate(copyMapDataElements copyDataElement,
               freeMapKeyElements freeKeyElement,
               compareMapKeyElements compareKeyElements);
 
+/**
+* mapCreateFromSorted: Allocates a new map holding copies of the given key and
+* data pairs. The map is built in one pass over the arrays when the keys are
+* sorted in increasing order, otherwise the pairs are sorted first.
+* If a key appears more than once, the data of its last pair is kept.
+*
+* @param copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+*   compareKeyElements - the element functions, the same as in mapCreate
+* @param keyElements - the keys to put in the map
+* @param dataElements - the data paired to each key
+* @param size - the number of pairs
+* @return
+* 	NULL - if one of the parameters is NULL or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateFromSorted(copyMapDataElements copyDataElement,
+                        copyMapKeyElements copyKeyElement,
+                        freeMapDataElements freeDataElement,
+                        freeMapKeyElements freeKeyElement,
+                        compareMapKeyElements compareKeyElements,
+                        MapKeyElement* keyElements,
+                        MapDataElement* dataElements, int size);
+
 /**
 * mapDestroy: Deallocates an existing map. Clears all elements by using the
 * stored free functions.
@@ -159,6 +235,46 @@ bool mapContains(Map map, MapKeyElement element);
 */
 MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement);
 
+/**
+*	mapPutAll: Puts arrays of key and data pairs in the map, the same as
+*  calling mapPut for each pair in order. The pairs are put in increasing key
+*  order through a position hint, so sorted keys take O(1) each, otherwise
+*  they are sorted first.
+*  Iterator's value is undefined after this operation.
+*
+* @param map - The map to put the pairs in
+* @param keyElements - The keys to put in the map
+* @param dataElements - The data paired to each key
+* @param size - The number of pairs
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or inside the arrays
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the pairs put before the
+* 	failure stay in the map
+* 	MAP_SUCCESS the pairs had been inserted successfully
+*/
+MapResult mapPutAll(Map map, MapKeyElement* keyElements,
+                    MapDataElement* dataElements, int size);
+
+/**
+*	mapPutHint: Gives a specified key a specific value, the same as mapPut, but
+*  the search for the place of the key starts from the place of the last key
+*  put with the same hint. Putting keys in increasing order takes O(1) each.
+*  The hint stays valid until keys are removed from the map.
+*  Iterator's value is undefined after this operation.
+*
+* @param map - The map for which to reassign the data element
+* @param hint - The position hint, updated to the place of the key. If hint
+*  is NULL this is the same as mapPut
+* @param keyElement - The key element which need to be reassigned
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map
+* 	MAP_OUT_OF_MEMORY if an allocation failed
+* 	MAP_SUCCESS the paired elements had been inserted successfully
+*/
+MapResult mapPutHint(Map map, MapHint* hint, MapKeyElement keyElement,
+                     MapDataElement dataElement);
+
 /**
 *	mapGet: Returns the data associated with a specific key in the map.
 *			Iterator status unchanged
@@ -218,6 +334,70 @@ MapKeyElement mapGetFirst(Map map);
 */
 MapKeyElement mapGetNext(Map map);
 
+/**
+*	mapGetKth: Sets the internal iterator to the key element with exactly k
+*	smaller key elements in the map and returns it, mapGetNext continues from
+*	it in increasing order. Takes O(log n).
+*
+* @param map - The map for which to set the iterator
+* @param k - The number of smaller keys, from 0 to the size of the map minus
+* 		one
+* @return
+* 	NULL if a NULL pointer was sent or k is out of range.
+* 	The k-th smallest key element of the map otherwise
+*/
+MapKeyElement mapGetKth(Map map, int k);
+
+/**
+*	mapRank: Returns the number of key elements in the map which are smaller
+*	than the given key, which does not have to be in the map. For a key in
+*	the map, mapGetKth(map, mapRank(map, key)) returns it. Takes O(log n).
+*	Iterator status unchanged
+*
+* @param map - The map to count the keys in
+* @param keyElement - The key to compare to
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	The number of smaller key elements otherwise
+*/
+int mapRank(Map map, MapKeyElement keyElement);
+
+/**
+*	mapRangeForEach: Calls a function for every pair of the map whose key is
+*	between lowKey and highKey, including both, in increasing key order.
+*	The function must not change the map.
+*	Iterator status unchanged
+*
+* @param map - The map to go over
+* @param lowKey - The smallest key of the range
+* @param highKey - The largest key of the range
+* @param action - The function to call with each key, its data and context
+* @param context - Passed to every call of action
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	The number of pairs action was called with otherwise
+*/
+int mapRangeForEach(Map map, MapKeyElement lowKey, MapKeyElement highKey,
+                    mapRangeAction action, void* context);
+
+/**
+*	mapGetStats: Returns the operation counters of the map, see MapStats.
+*	The counters are updated atomically so a map searched by several threads
+*	at once counts all of their searches.
+*	Iterator status unchanged
+*
+* @param map - The map to return the counters of
+* @return
+* 	All zero counters if a NULL pointer was sent.
+* 	The counters of the map since it was created or last reset otherwise
+*/
+MapStats mapGetStats(Map map);
+
+/**
+*	mapResetStats: Zeroes the operation counters of the map. Does nothing for
+*	NULL. Iterator status unchanged
+*/
+void mapResetStats(Map map);
 
 /**
 * mapClear: Removes all key and data elements from target map.
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "memstat.h"
+
+/**
+* The header in front of every block, padded to the alignment malloc gives so
+* the block after it is aligned the same.
+*/
+typedef union Header_t
+{
+    struct
+    {
+        size_t size;
+        MemstatSubsystem subsystem;
+    } info;
+    long double alignment;
+} Header;
+
+static MemstatCounters counters[MEMSTAT_SUBSYSTEMS];
+
+/**
+* this function counts a new block of a subsystem, and raises the peak of the
+* subsystem if needed.
+*/
+static void countAllocation(MemstatSubsystem subsystem, size_t size)
+{
+    MemstatCounters *counter=counters+subsystem;
+    long live=__atomic_add_fetch(&counter->live_bytes,(long)size,
+                                 __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counter->live_allocations,1,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&counter->total_allocations,1,__ATOMIC_RELAXED);
+    long peak=__atomic_load_n(&counter->peak_bytes,__ATOMIC_RELAXED);
+    while(live>peak && !__atomic_compare_exchange_n(&counter->peak_bytes,
+                                                    &peak,live,true,
+                                                    __ATOMIC_RELAXED,
+                                                    __ATOMIC_RELAXED))
+    {
+    }
+}
+
+static void countFree(MemstatSubsystem subsystem, size_t size)
+{
+    MemstatCounters *counter=counters+subsystem;
+    __atomic_sub_fetch(&counter->live_bytes,(long)size,__ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counter->live_allocations,1,__ATOMIC_RELAXED);
+}
+
+void* memstatMalloc(MemstatSubsystem subsystem, size_t size)
+{
+    if(size>(size_t)-1-sizeof(Header))
+    {
+        return NULL;
+    }
+    Header* header=malloc(sizeof(Header)+size);
+    if(!header)
+    {
+        return NULL;
+    }
+    header->info.size=size;
+    header->info.subsystem=subsystem;
+    countAllocation(subsystem,size);
+    return header+1;
+}
+
+void* memstatCalloc(MemstatSubsystem subsystem, size_t num, size_t size)
+{
+    if(size && num>((size_t)-1-sizeof(Header))/size)
+    {
+        return NULL;
+    }
+    Header* header=calloc(1,sizeof(Header)+num*size);
+    if(!header)
+    {
+        return NULL;
+    }
+    header->info.size=num*size;
+    header->info.subsystem=subsystem;
+    countAllocation(subsystem,num*size);
+    return header+1;
+}
+
+void* memstatRealloc(MemstatSubsystem subsystem, void* block, size_t size)
+{
+    if(!block)
+    {
+        return memstatMalloc(subsystem,size);
+    }
+    if(size>(size_t)-1-sizeof(Header))
+    {
+        return NULL;
+    }
+    Header* header=(Header*)block-1;
+    size_t old_size=header->info.size;
+    subsystem=header->info.subsystem;
+    header=realloc(header,sizeof(Header)+size);
+    if(!header)
+    {
+        return NULL;
+    }
+    header->info.size=size;
+    countFree(subsystem,old_size);
+    countAllocation(subsystem,size);
+    __atomic_sub_fetch(&counters[subsystem].total_allocations,1,
+                       __ATOMIC_RELAXED);
+    return header+1;
+}
+
+void memstatFree(void* block)
+{
+    if(!block)
+    {
+        return;
+    }
+    Header* header=(Header*)block-1;
+    countFree(header->info.subsystem,header->info.size);
+    free(header);
+}
+
+MemstatCounters memstatGet(MemstatSubsystem subsystem)
+{
+    MemstatCounters result={0,0,0,0};
+    int first=subsystem==MEMSTAT_SUBSYSTEMS ? 0 : subsystem;
+    int last=subsystem==MEMSTAT_SUBSYSTEMS ? MEMSTAT_SUBSYSTEMS-1 : subsystem;
+    for(int i=first; i<=last; i++)
+    {
+        result.live_bytes+=__atomic_load_n(&counters[i].live_bytes,
+                                           __ATOMIC_RELAXED);
+        result.live_allocations+=
+                __atomic_load_n(&counters[i].live_allocations,
+                                __ATOMIC_RELAXED);
+        result.peak_bytes+=__atomic_load_n(&counters[i].peak_bytes,
+                                           __ATOMIC_RELAXED);
+        result.total_allocations+=
+                __atomic_load_n(&counters[i].total_allocations,
+                                __ATOMIC_RELAXED);
+    }
+    return result;
+}
@@ -0,0 +1,81 @@
+#ifndef MEMSTAT_H_
+#define MEMSTAT_H_
+
+#include <stddef.h>
+
+/**
+* Allocation Accounting
+*
+* Wraps malloc, calloc, realloc and free, and counts the live bytes and
+* allocations of each subsystem of the program. Every block carries a small
+* header with its size and subsystem, so a block is freed with memstatFree no
+* matter which subsystem allocated it. Blocks from memstat must not be passed
+* to free, and blocks from malloc must not be passed to memstatFree.
+* The counters are shared by the whole process and may be updated by several
+* threads at once.
+*
+* The following functions are available:
+*   memstatMalloc	- Allocates a block for a subsystem
+*   memstatCalloc	- Allocates a zeroed block for a subsystem
+*   memstatRealloc	- Resizes a block, keeping its subsystem
+*   memstatFree		- Frees a block
+*   memstatGet		- Returns the counters of a subsystem
+*/
+
+/** The subsystems memory is counted for */
+typedef enum MemstatSubsystem_t {
+    MEMSTAT_MAP,
+    MEMSTAT_JUDGE,
+    MEMSTAT_COUNTRY,
+    MEMSTAT_EUROVISION,
+    MEMSTAT_SIMULATION,
+    MEMSTAT_LIST,
+    MEMSTAT_SUBSYSTEMS
+} MemstatSubsystem;
+
+/** The counters of one subsystem */
+typedef struct MemstatCounters_t {
+    long live_bytes;
+    long live_allocations;
+    long peak_bytes;
+    long total_allocations;
+} MemstatCounters;
+
+/**
+* memstatMalloc: Allocates a block and counts it for a subsystem.
+* @return
+* 	NULL if the allocation failed, the block otherwise.
+*/
+void* memstatMalloc(MemstatSubsystem subsystem, size_t size);
+
+/**
+* memstatCalloc: Allocates a zeroed block of num elements and counts it for a
+* subsystem.
+* @return
+* 	NULL if the allocation failed, the block otherwise.
+*/
+void* memstatCalloc(MemstatSubsystem subsystem, size_t num, size_t size);
+
+/**
+* memstatRealloc: Resizes a block the same as realloc. A NULL block is
+* allocated for the given subsystem, an existing block keeps the subsystem it
+* was allocated for.
+* @return
+* 	NULL if the allocation failed and the block was not changed, the resized
+* 	block otherwise.
+*/
+void* memstatRealloc(MemstatSubsystem subsystem, void* block, size_t size);
+
+/**
+* memstatFree: Frees a block allocated by memstat. Does nothing for NULL.
+*/
+void memstatFree(void* block);
+
+/**
+* memstatGet: Returns the counters of a subsystem, the counters of
+* MEMSTAT_SUBSYSTEMS are the sums of the counters of all the subsystems, so
+* their peak is the sum of the peaks.
+*/
+MemstatCounters memstatGet(MemstatSubsystem subsystem);
+
+#endif /* MEMSTAT_H_ */
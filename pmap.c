@@ -0,0 +1,655 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "pmap.h"
+#include "memstat.h"
+#include <stdbool.h>
+
+#define ILLEGAL -1
+
+typedef struct PEntry_t* PEntry;
+typedef struct PNode_t* PNode;
+
+/**
+ * A key and its data, shared by all the tree nodes (of all the copies) that
+ * hold them. refs counts those nodes.
+ */
+struct PEntry_t
+{
+    MapKeyElement key;
+    MapDataElement data;
+    int refs;
+};
+
+/**
+ * An AVL tree node, shared by all the copies of the map that did not change
+ * it. refs counts the parent nodes and maps pointing to the node, a node is
+ * only changed in place while it is not shared.
+ */
+struct PNode_t
+{
+    PEntry entry;
+    PNode left;
+    PNode right;
+    int height;
+    int refs;
+};
+
+struct PMap_t
+{
+    copyMapKeyElements copy_key;
+    copyMapDataElements copy_data;
+    freeMapKeyElements free_key;
+    freeMapDataElements free_data;
+    compareMapKeyElements cmp_key;
+    PNode root;
+    PEntry current;
+    int size;
+};
+
+/**
+ * The reference counts are updated atomically since copies of a map may be
+ * destroyed by other threads.
+ */
+static void retainCount(int* refs)
+{
+    __atomic_add_fetch(refs, 1, __ATOMIC_RELAXED);
+}
+
+static bool releaseCount(int* refs)
+{
+    return __atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+static bool isShared(PNode node)
+{
+    return __atomic_load_n(&node->refs, __ATOMIC_ACQUIRE) > 1;
+}
+
+/**
+ * This function creates a new entry holding copies of the given key and data.
+ *
+ * @param map
+ * @param keyElement
+ * @param dataElement
+ * @return
+ * NULL if an allocation failed
+ * the new entry otherwise
+ */
+static PEntry entryCreate(PMap map, MapKeyElement keyElement,
+                          MapDataElement dataElement)
+{
+    PEntry entry=memstatMalloc(MEMSTAT_MAP,sizeof(*entry));
+    if(!entry)
+    {
+        return NULL;
+    }
+    entry->key=map->copy_key(keyElement);
+    entry->data=map->copy_data(dataElement);
+    if(!entry->key || !entry->data)
+    {
+        if(entry->key)
+        {
+            map->free_key(entry->key);
+        }
+        if(entry->data)
+        {
+            map->free_data(entry->data);
+        }
+        memstatFree(entry);
+        return NULL;
+    }
+    entry->refs=1;
+    return entry;
+}
+
+static void entryRelease(PMap map, PEntry entry)
+{
+    if(entry && releaseCount(&entry->refs))
+    {
+        map->free_key(entry->key);
+        map->free_data(entry->data);
+        memstatFree(entry);
+    }
+}
+
+static PNode nodeRetain(PNode node)
+{
+    if(node)
+    {
+        retainCount(&node->refs);
+    }
+    return node;
+}
+
+/**
+ * This function drops a reference to a node, a node that is no longer
+ * referenced is freed together with the references it holds.
+ *
+ * @param map
+ * @param node
+ */
+static void nodeRelease(PMap map, PNode node)
+{
+    if(node && releaseCount(&node->refs))
+    {
+        entryRelease(map, node->entry);
+        nodeRelease(map, node->left);
+        nodeRelease(map, node->right);
+        memstatFree(node);
+    }
+}
+
+static int nodeHeight(PNode node)
+{
+    return node ? node->height : 0;
+}
+
+static void updateHeight(PNode node)
+{
+    int left=nodeHeight(node->left), right=nodeHeight(node->right);
+    node->height=(left > right ? left : right)+1;
+}
+
+/**
+ * This function creates a new leaf node which takes the reference to the
+ * given entry.
+ *
+ * @param entry
+ * @return
+ * NULL if an allocation failed
+ * the new node otherwise
+ */
+static PNode nodeCreate(PEntry entry)
+{
+    PNode node=memstatMalloc(MEMSTAT_MAP,sizeof(*node));
+    if(!node)
+    {
+        return NULL;
+    }
+    node->entry=entry;
+    node->left=NULL;
+    node->right=NULL;
+    node->height=1;
+    node->refs=1;
+    return node;
+}
+
+/**
+ * This function creates an unshared copy of a node, the copy shares the
+ * entry and the children of the original node.
+ *
+ * @param node
+ * @return
+ * NULL if an allocation failed
+ * the new node otherwise
+ */
+static PNode nodeClone(PNode node)
+{
+    PNode copy=memstatMalloc(MEMSTAT_MAP,sizeof(*copy));
+    if(!copy)
+    {
+        return NULL;
+    }
+    copy->entry=node->entry;
+    retainCount(&copy->entry->refs);
+    copy->left=nodeRetain(node->left);
+    copy->right=nodeRetain(node->right);
+    copy->height=node->height;
+    copy->refs=1;
+    return copy;
+}
+
+/**
+ * This function makes sure the node a link points to can be changed in
+ * place, a shared node is replaced by an unshared copy.
+ *
+ * @param map
+ * @param link - the child pointer of an unshared node
+ * @return
+ * NULL if an allocation failed
+ * the unshared node otherwise
+ */
+static PNode makeUnique(PMap map, PNode* link)
+{
+    if(isShared(*link))
+    {
+        PNode copy=nodeClone(*link);
+        if(!copy)
+        {
+            return NULL;
+        }
+        nodeRelease(map, *link);
+        *link=copy;
+    }
+    return *link;
+}
+
+/**
+ * Rotations take an unshared node and return the new root of its subtree.
+ * The child moved up is unshared first, if that fails the subtree is returned
+ * unrotated, it stays a valid search tree but a less balanced one.
+ */
+static PNode rotateRight(PMap map, PNode node)
+{
+    PNode left=makeUnique(map, &node->left);
+    if(!left)
+    {
+        return node;
+    }
+    node->left=left->right;
+    left->right=node;
+    updateHeight(node);
+    updateHeight(left);
+    return left;
+}
+
+static PNode rotateLeft(PMap map, PNode node)
+{
+    PNode right=makeUnique(map, &node->right);
+    if(!right)
+    {
+        return node;
+    }
+    node->right=right->left;
+    right->left=node;
+    updateHeight(node);
+    updateHeight(right);
+    return right;
+}
+
+/**
+ * This function restores the AVL balance of an unshared node whose subtrees
+ * are balanced.
+ *
+ * @param map
+ * @param node
+ * @return
+ * the new root of the subtree
+ */
+static PNode rebalance(PMap map, PNode node)
+{
+    updateHeight(node);
+    int balance=nodeHeight(node->left)-nodeHeight(node->right);
+    if(balance > 1)
+    {
+        if(nodeHeight(node->left->left) < nodeHeight(node->left->right))
+        {
+            PNode left=makeUnique(map, &node->left);
+            if(!left)
+            {
+                return node;
+            }
+            node->left=rotateLeft(map, left);
+        }
+        return rotateRight(map, node);
+    }
+    if(balance < -1)
+    {
+        if(nodeHeight(node->right->right) < nodeHeight(node->right->left))
+        {
+            PNode right=makeUnique(map, &node->right);
+            if(!right)
+            {
+                return node;
+            }
+            node->right=rotateRight(map, right);
+        }
+        return rotateLeft(map, node);
+    }
+    return node;
+}
+
+/**
+ * This function puts a key in the subtree of node. Nodes on the path to the
+ * key are changed in place if no other map or node can reach them, and
+ * copied otherwise.
+ *
+ * @param map
+ * @param node - the root of the subtree, the caller keeps its reference
+ * @param shared - whether an ancestor of node is shared
+ * @param keyElement
+ * @param dataElement
+ * @param added - set to true if the key was not in the subtree
+ * @return
+ * NULL if an allocation failed, the subtree is left unchanged
+ * a new reference to the root of the changed subtree otherwise
+ */
+static PNode nodeInsert(PMap map, PNode node, bool shared,
+                        MapKeyElement keyElement, MapDataElement dataElement,
+                        bool* added)
+{
+    if(!node)
+    {
+        PEntry entry=entryCreate(map, keyElement, dataElement);
+        if(!entry)
+        {
+            return NULL;
+        }
+        PNode leaf=nodeCreate(entry);
+        if(!leaf)
+        {
+            entryRelease(map, entry);
+            return NULL;
+        }
+        *added=true;
+        return leaf;
+    }
+    shared=shared || isShared(node);
+    int cmp=map->cmp_key(keyElement, node->entry->key);
+    PNode target=shared ? nodeClone(node) : nodeRetain(node);
+    if(!target)
+    {
+        return NULL;
+    }
+    if(cmp==0)
+    {
+        PEntry entry=entryCreate(map, keyElement, dataElement);
+        if(!entry)
+        {
+            nodeRelease(map, target);
+            return NULL;
+        }
+        entryRelease(map, target->entry);
+        target->entry=entry;
+        return target;
+    }
+    PNode* link=cmp < 0 ? &target->left : &target->right;
+    PNode child=nodeInsert(map, *link, shared, keyElement, dataElement,
+                           added);
+    if(!child)
+    {
+        nodeRelease(map, target);
+        return NULL;
+    }
+    nodeRelease(map, *link);
+    *link=child;
+    return rebalance(map, target);
+}
+
+/**
+ * This function removes a key from the subtree of node, the same way
+ * nodeInsert changes it.
+ *
+ * @param map
+ * @param node - the root of the subtree, the caller keeps its reference
+ * @param shared - whether an ancestor of node is shared
+ * @param keyElement
+ * @param result - set to MAP_SUCCESS, MAP_ITEM_DOES_NOT_EXIST or
+ * MAP_OUT_OF_MEMORY, the subtree is left unchanged unless it is MAP_SUCCESS
+ * @return
+ * a new reference to the root of the changed subtree, which may be NULL
+ */
+static PNode nodeRemove(PMap map, PNode node, bool shared,
+                        MapKeyElement keyElement, MapResult* result)
+{
+    if(!node)
+    {
+        *result=MAP_ITEM_DOES_NOT_EXIST;
+        return NULL;
+    }
+    shared=shared || isShared(node);
+    int cmp=map->cmp_key(keyElement, node->entry->key);
+    PEntry entry=NULL;
+    PNode child;
+    if(cmp==0)
+    {
+        if(!node->left || !node->right)
+        {
+            *result=MAP_SUCCESS;
+            return nodeRetain(node->left ? node->left : node->right);
+        }
+        PNode min=node->right;
+        while(min->left)
+        {
+            min=min->left;
+        }
+        entry=min->entry;
+        retainCount(&entry->refs);
+        child=nodeRemove(map, node->right, shared, entry->key, result);
+        cmp=1;
+    }
+    else
+    {
+        child=nodeRemove(map, cmp < 0 ? node->left : node->right, shared,
+                         keyElement, result);
+    }
+    if(*result!=MAP_SUCCESS)
+    {
+        entryRelease(map, entry);
+        return NULL;
+    }
+    PNode target=shared ? nodeClone(node) : nodeRetain(node);
+    if(!target)
+    {
+        entryRelease(map, entry);
+        nodeRelease(map, child);
+        *result=MAP_OUT_OF_MEMORY;
+        return NULL;
+    }
+    if(entry)
+    {
+        entryRelease(map, target->entry);
+        target->entry=entry;
+    }
+    PNode* link=cmp < 0 ? &target->left : &target->right;
+    nodeRelease(map, *link);
+    *link=child;
+    return rebalance(map, target);
+}
+
+/**
+ * This function finds the node holding a key equal to the given key.
+ *
+ * @param map
+ * @param keyElement
+ * @return
+ * NULL if the key is not in the map
+ * the node of the key otherwise
+ */
+static PNode nodeFind(PMap map, MapKeyElement keyElement)
+{
+    PNode node=map->root;
+    int cmp;
+    while(node)
+    {
+        cmp=map->cmp_key(keyElement, node->entry->key);
+        if(cmp==0)
+        {
+            return node;
+        }
+        node=cmp < 0 ? node->left : node->right;
+    }
+    return NULL;
+}
+
+/**
+ * This function moves the internal iterator to the given entry, holding a
+ * reference so the key stays valid while the iterator points to it.
+ *
+ * @param map
+ * @param entry
+ * @return
+ * the key of the entry, NULL if entry is NULL
+ */
+static MapKeyElement setCurrent(PMap map, PEntry entry)
+{
+    if(entry)
+    {
+        retainCount(&entry->refs);
+    }
+    entryRelease(map, map->current);
+    map->current=entry;
+    return entry ? entry->key : NULL;
+}
+
+PMap pmapCreate(copyMapDataElements copyDataElement,
+                copyMapKeyElements copyKeyElement,
+                freeMapDataElements freeDataElement,
+                freeMapKeyElements freeKeyElement,
+                compareMapKeyElements compareKeyElements)
+{
+    if((!copyDataElement)||(!copyKeyElement)||(!freeDataElement)||
+       (!freeKeyElement)||(!compareKeyElements))
+    {
+        return NULL;
+    }
+    PMap map=memstatMalloc(MEMSTAT_MAP,sizeof(*map));
+    if(!map)
+    {
+        return NULL;
+    }
+    map->copy_key=copyKeyElement;
+    map->copy_data=copyDataElement;
+    map->free_key=freeKeyElement;
+    map->free_data=freeDataElement;
+    map->cmp_key=compareKeyElements;
+    map->root=NULL;
+    map->current=NULL;
+    map->size=0;
+    return map;
+}
+
+void pmapDestroy(PMap map)
+{
+    if(!map)
+    {
+        return;
+    }
+    pmapClear(map);
+    memstatFree(map);
+}
+
+PMap pmapCopy(PMap map)
+{
+    if(!map)
+    {
+        return NULL;
+    }
+    PMap new_map=pmapCreate(map->copy_data,map->copy_key,map->free_data,
+                            map->free_key,map->cmp_key);
+    if(!new_map)
+    {
+        return NULL;
+    }
+    new_map->root=nodeRetain(map->root);
+    new_map->size=map->size;
+    return new_map;
+}
+
+int pmapGetSize(PMap map)
+{
+    if(!map)
+    {
+        return ILLEGAL;
+    }
+    return map->size;
+}
+
+bool pmapContains(PMap map, MapKeyElement element)
+{
+    if(!map || !element)
+    {
+        return false;
+    }
+    return nodeFind(map, element)!=NULL;
+}
+
+MapResult pmapPut(PMap map, MapKeyElement keyElement,
+                  MapDataElement dataElement)
+{
+    if(!map || !keyElement || !dataElement)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    bool added=false;
+    PNode root=nodeInsert(map, map->root, false, keyElement, dataElement,
+                          &added);
+    if(!root)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    nodeRelease(map, map->root);
+    map->root=root;
+    if(added)
+    {
+        map->size++;
+    }
+    return MAP_SUCCESS;
+}
+
+MapDataElement pmapGet(PMap map, MapKeyElement keyElement)
+{
+    if(!map || !keyElement)
+    {
+        return NULL;
+    }
+    PNode node=nodeFind(map, keyElement);
+    return node ? node->entry->data : NULL;
+}
+
+MapResult pmapRemove(PMap map, MapKeyElement keyElement)
+{
+    if(!map || !keyElement)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    MapResult result=MAP_SUCCESS;
+    PNode root=nodeRemove(map, map->root, false, keyElement, &result);
+    if(result!=MAP_SUCCESS)
+    {
+        return result;
+    }
+    nodeRelease(map, map->root);
+    map->root=root;
+    map->size--;
+    return MAP_SUCCESS;
+}
+
+MapKeyElement pmapGetFirst(PMap map)
+{
+    if(!map || !map->root)
+    {
+        return NULL;
+    }
+    PNode node=map->root;
+    while(node->left)
+    {
+        node=node->left;
+    }
+    return setCurrent(map, node->entry);
+}
+
+MapKeyElement pmapGetNext(PMap map)
+{
+    if(!map || !map->current)
+    {
+        return NULL;
+    }
+    PNode node=map->root, next=NULL;
+    while(node)
+    {
+        if(map->cmp_key(map->current->key, node->entry->key) < 0)
+        {
+            next=node;
+            node=node->left;
+        }
+        else
+        {
+            node=node->right;
+        }
+    }
+    return setCurrent(map, next ? next->entry : NULL);
+}
+
+MapResult pmapClear(PMap map)
+{
+    if(!map)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    setCurrent(map, NULL);
+    nodeRelease(map, map->root);
+    map->root=NULL;
+    map->size=0;
+    return MAP_SUCCESS;
+}
@@ -0,0 +1,197 @@
+#ifndef PMAP_H_
+#define PMAP_H_
+
+#include <stdbool.h>
+#include "map.h"
+
+/**
+* Persistent Map Container
+*
+* Implements an ordered map with the same element functions as Map, whose
+* copies share their structure. Copying a map takes O(1), and changing a map
+* copies only the O(log n) tree nodes on the path to the changed key, so a
+* copy can be kept as a cheap snapshot while the original keeps changing.
+*
+* Elements are shared between a map and its copies, so the data returned by
+* pmapGet must not be changed in place, use pmapPut instead.
+* A map and its copies may be used by different threads as long as every
+* single map is used by one thread at a time.
+*
+* The following functions are available:
+*   pmapCreate		- Creates a new empty map
+*   pmapDestroy		- Deletes an existing map and frees all resources
+*   pmapCopy		- Copies an existing map in O(1)
+*   pmapGetSize		- Returns the size of a given map
+*   pmapContains	- Returns weather or not a key exists inside the map.
+*   pmapPut		- Gives a specific key a given value.
+*   				  If the key exists, the value is overridden.
+*   pmapGet		- Returns the data paired to a key which matches the given
+*   				  key. Iterator status unchanged
+*   pmapRemove		- Removes a pair of (key,data) elements for which the key
+*   				  matches a given element.
+*   pmapGetFirst	- Sets the internal iterator to the smallest key in the
+*   				  map, and returns it.
+*   pmapGetNext		- Advances the internal iterator to the next key in
+*   				  increasing order and returns it.
+*   pmapClear		- Clears the contents of the map.
+*   PMAP_FOREACH	- A macro for iterating over the map's elements.
+*/
+
+/** Type for defining the persistent map */
+typedef struct PMap_t *PMap;
+
+/**
+* pmapCreate: Allocates a new empty persistent map.
+*
+* @param copyDataElement - Function pointer to be used for copying data
+*   elements into the map.
+* @param copyKeyElement - Function pointer to be used for copying key elements
+*   into the map.
+* @param freeDataElement - Function pointer to be used for removing data
+*   elements from the map
+* @param freeKeyElement - Function pointer to be used for removing key
+*   elements from the map
+* @param compareKeyElements - Function pointer to be used for comparing key
+*   elements inside the map.
+* @return
+* 	NULL - if one of the parameters is NULL or allocations failed.
+* 	A new PMap in case of success.
+*/
+PMap pmapCreate(copyMapDataElements copyDataElement,
+                copyMapKeyElements copyKeyElement,
+                freeMapDataElements freeDataElement,
+                freeMapKeyElements freeKeyElement,
+                compareMapKeyElements compareKeyElements);
+
+/**
+* pmapDestroy: Deallocates an existing map. Elements no longer shared with
+* another copy are freed using the stored free functions.
+*
+* @param map - Target map to be deallocated. If map is NULL nothing will be
+* 		done
+*/
+void pmapDestroy(PMap map);
+
+/**
+* pmapCopy: Creates a copy of target map in O(1), the copy shares all the
+* elements of map until one of them changes.
+*
+* @param map - Target map.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	A PMap containing the same elements as map otherwise.
+*/
+PMap pmapCopy(PMap map);
+
+/**
+* pmapGetSize: Returns the number of elements in a map
+* @param map - The map which size is requested
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the map.
+*/
+int pmapGetSize(PMap map);
+
+/**
+* pmapContains: Checks if a key element exists in the map.
+*
+* @param map - The map to search in
+* @param element - The element to look for.
+* @return
+* 	false - if one or more of the inputs is null, or if the key element was
+* 	not found.
+* 	true - if the key element was found in the map.
+*/
+bool pmapContains(PMap map, MapKeyElement element);
+
+/**
+* pmapPut: Gives a specified key a specific value, copies of the map are not
+* affected. Iterator's value is undefined after this operation.
+*
+* @param map - The map for which to reassign the data element
+* @param keyElement - The key element which need to be reassigned
+* @param dataElement - The new data element to associate with the given key.
+*      A copy of the element will be inserted as supplied by the copying
+*      function which is given at initialization.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the map is left unchanged
+* 	MAP_SUCCESS the paired elements had been inserted successfully
+*/
+MapResult pmapPut(PMap map, MapKeyElement keyElement,
+                  MapDataElement dataElement);
+
+/**
+* pmapGet: Returns the data associated with a specific key in the map.
+* The data may be shared with copies of the map and must not be changed.
+* Iterator status unchanged
+*
+* @param map - The map for which to get the data element from.
+* @param keyElement - The key element which need to be found.
+* @return
+*  NULL if a NULL pointer was sent or if the map does not contain the
+*  requested key.
+* 	The data element associated with the key otherwise.
+*/
+MapDataElement pmapGet(PMap map, MapKeyElement keyElement);
+
+/**
+* pmapRemove: Removes a pair of key and data elements from the map, copies of
+* the map are not affected. Iterator's value is undefined after this
+* operation.
+*
+* @param map - The map to remove the elements from.
+* @param keyElement - The key element to find and remove from the map.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent to the function
+* 	MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exists in
+* 	the map
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the map is left unchanged
+* 	MAP_SUCCESS the paired elements had been removed successfully
+*/
+MapResult pmapRemove(PMap map, MapKeyElement keyElement);
+
+/**
+* pmapGetFirst: Sets the internal iterator to the smallest key element in the
+* map and returns it.
+*
+* @param map - The map for which to set the iterator.
+* @return
+* 	NULL if a NULL pointer was sent or the map is empty.
+* 	The first key element of the map otherwise
+*/
+MapKeyElement pmapGetFirst(PMap map);
+
+/**
+* pmapGetNext: Advances the map iterator to the next key element in
+* increasing order and returns it.
+*
+* @param map - The map for which to advance the iterator
+* @return
+* 	NULL if reached the end of the map, or the iterator is at an invalid state
+* 	or a NULL sent as argument
+* 	The next key element on the map in case of success
+*/
+MapKeyElement pmapGetNext(PMap map);
+
+/**
+* pmapClear: Removes all key and data elements from target map, copies of the
+* map are not affected.
+*
+* @param map - Target map to remove all element from.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult pmapClear(PMap map);
+
+/*!
+* Macro for iterating over a persistent map in increasing key order.
+* Declares a new iterator for the loop.
+*/
+#define PMAP_FOREACH(type, iterator, map) \
+    for(type iterator = (type) pmapGetFirst(map) ; \
+        iterator ;\
+        iterator = pmapGetNext(map))
+
+#endif /* PMAP_H_ */
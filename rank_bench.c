@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ranking.h"
+
+#define MIN_STATES 1000
+#define MAX_STATES 1000000
+#define DEFAULT_JUDGES 20
+/* every size sorts about this many countries in total */
+#define SORTED_PER_SIZE 10000000
+#define PERCENT 50
+#define TOP_K 10
+#define MAX_POINTS 12
+#define METHODS 4
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC,&time);
+    return time.tv_sec+time.tv_nsec/1e9;
+}
+
+/**
+* this function returns the next number of a xorshift random sequence.
+* @param state - the state of the sequence, updated.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+    unsigned int x=*state;
+    x^=x<<13;
+    x^=x>>17;
+    x^=x<<5;
+    *state=x;
+    return x;
+}
+
+/**
+* this function fills the contest scores of states countries ordered by id,
+* as the contest cache holds them. each country gets the points of a random
+* number of voters and judges, so most scores are small and many are tied.
+* @param countries - receives the countries.
+* @param states - number of countries.
+* @param judges - number of judges.
+*/
+static void fillScores(ScoredCountry *countries, int states, int judges)
+{
+    unsigned int seed=2463534242u;
+    for(int i=0; i<states; i++)
+    {
+        int audience=nextRandom(&seed)%(MAX_POINTS*4+1);
+        int judges_points=judges ? nextRandom(&seed)%(MAX_POINTS*judges+1) : 0;
+        countries[i].id=i;
+        countries[i].score=rankingContestScore(audience,judges_points,PERCENT,
+                                               states-1,judges);
+    }
+}
+
+/**
+* this function times one ranking method over the given countries, each round
+* works on a fresh copy of them.
+* @param method - 0 qsort, 1 radix sort, 2 radix sort of shuffled ids, 3 top
+* ten with a heap.
+* @param countries - the countries, ordered by id.
+* @param work - room for 2 * states countries.
+* @param states - number of countries.
+* @param rounds - number of times to rank.
+* @return
+* 	the average time of one round in seconds.
+*/
+static double benchRanking(int method, const ScoredCountry *countries,
+                           ScoredCountry *work, int states, int rounds)
+{
+    double total=0;
+    for(int round=0; round<rounds; round++)
+    {
+        memcpy(work,countries,sizeof(*work)*states);
+        if(method==2)
+        {
+            unsigned int seed=88675123u+round;
+            for(int i=states-1; i>0; i--)
+            {
+                int j=nextRandom(&seed)%(i+1);
+                ScoredCountry tmp=work[i];
+                work[i]=work[j];
+                work[j]=tmp;
+            }
+        }
+        double start=now();
+        if(method==0)
+        {
+            rankingSort(work,states);
+        }
+        else if(method==3)
+        {
+            rankingTopK(work,states,TOP_K,work+states);
+        }
+        else
+        {
+            rankingRadixSort(work,states,work+states);
+        }
+        total+=now()-start;
+    }
+    return total/rounds;
+}
+
+int main(int argc, char** argv)
+{
+    int judges=argc>1 ? atoi(argv[1]) : DEFAULT_JUDGES;
+    if(judges<0)
+    {
+        fprintf(stderr,"usage: %s [judges]\n",argv[0]);
+        return 1;
+    }
+    ScoredCountry *countries=malloc(sizeof(*countries)*MAX_STATES);
+    ScoredCountry *work=malloc(sizeof(*work)*2*MAX_STATES);
+    if(countries==NULL || work==NULL)
+    {
+        free(countries);
+        free(work);
+        fprintf(stderr,"out of memory\n");
+        return 1;
+    }
+    const char *methods[METHODS]={"rankingSort","rankingRadixSort",
+                                  "rankingRadixSort shuffled",
+                                  "rankingTopK 10"};
+    printf("judges: %d\n%10s",judges,"states");
+    for(int method=0; method<METHODS; method++)
+    {
+        printf(" %26s",methods[method]);
+    }
+    printf("\n");
+    for(int states=MIN_STATES; states<=MAX_STATES; states*=10)
+    {
+        fillScores(countries,states,judges);
+        printf("%10d",states);
+        for(int method=0; method<METHODS; method++)
+        {
+            printf(" %23.3f ms",benchRanking(method,countries,work,states,
+                                             SORTED_PER_SIZE/states)*1e3);
+        }
+        printf("\n");
+    }
+    free(countries);
+    free(work);
+    return 0;
+}
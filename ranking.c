@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ranking.h"
+#include <stdbool.h>
+
+#define PERCENT 100
+#define FIRST_SCORE 12
+#define SECOND_SCORE 10
+#define FIRST 0
+#define SECOND 1
+#define TOP_TEN_COUNTRIES 10
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define ID_DIGITS 4
+#define SCORE_DIGITS 8
+#define KEY_DIGITS (ID_DIGITS + SCORE_DIGITS)
+#define ID_SIGN 0x80000000u
+#define SCORE_SIGN 0x8000000000000000ull
+/* below this size a comparison sort is faster than the radix passes */
+#define RADIX_MIN_SIZE 256
+
+/**
+ * this function is used as a sorting function for qsort, it orders the
+ * countries from the highest ranked to the lowest ranked.
+ * @param first
+ * @param second
+ * @return
+ * negative if first is ranked before second
+ * positive otherwise
+ */
+static int compareScoredCountries(const void *first, const void *second) {
+    return rankingBetter(*(const ScoredCountry *) first,
+                         *(const ScoredCountry *) second) ? -1 : 1;
+}
+
+/**
+ * this function restores the heap order below the given index, the heap keeps
+ * the lowest ranked country at its root so it can be replaced when a better
+ * country shows up.
+ * @param heap
+ * @param heap_size
+ * @param index
+ */
+static void heapSiftDown(ScoredCountry *heap, int heap_size, int index) {
+    ScoredCountry tmp;
+    int child;
+    while ((child = 2 * index + 1) < heap_size) {
+        if (child + 1 < heap_size &&
+            rankingBetter(heap[child], heap[child + 1])) {
+            child++;
+        }
+        if (!rankingBetter(heap[index], heap[child])) {
+            return;
+        }
+        tmp = heap[index];
+        heap[index] = heap[child];
+        heap[child] = tmp;
+        index = child;
+    }
+}
+
+/**
+ * this function adds a country to the heap, the heap must have room for it.
+ * @param heap
+ * @param heap_size - the size of the heap before adding the country
+ * @param country
+ */
+static void heapPush(ScoredCountry *heap, int heap_size,
+                     ScoredCountry country) {
+    int index = heap_size, parent;
+    heap[index] = country;
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (!rankingBetter(heap[parent], heap[index])) {
+            return;
+        }
+        heap[index] = heap[parent];
+        heap[parent] = country;
+        index = parent;
+    }
+}
+
+/**
+ * this function returns a digit of the radix key of a country. The key is the
+ * score from the highest to the lowest in its higher digits and the id from
+ * the lowest to the highest in its lower digits, so sorting the keys from the
+ * lowest orders the countries from the best ranked.
+ * @param country
+ * @param digit - from 0, the lowest digit of the id, to KEY_DIGITS - 1
+ * @return
+ * the digit, from 0 to RADIX_SIZE - 1
+ */
+static int keyDigit(ScoredCountry country, int digit) {
+    if (digit < ID_DIGITS) {
+        return (((unsigned int) country.id ^ ID_SIGN) >> (digit * RADIX_BITS))
+               & (RADIX_SIZE - 1);
+    }
+    unsigned long long score = ~((unsigned long long) country.score ^
+                                 SCORE_SIGN);
+    return (score >> ((digit - ID_DIGITS) * RADIX_BITS)) & (RADIX_SIZE - 1);
+}
+
+long long rankingContestScore(int audience_points, int judges_points,
+                              int audience_percent, int countries_num,
+                              int judge_num) {
+    long long audience_score = (long long) audience_points * audience_percent;
+    if (!judge_num) {
+        return audience_score;
+    }
+    return audience_score * judge_num + (long long) judges_points *
+                                        (PERCENT - audience_percent) *
+                                        countries_num;
+}
+
+int rankingPlacePoints(int place) {
+    if (place == FIRST) {
+        return FIRST_SCORE;
+    }
+    if (place == SECOND) {
+        return SECOND_SCORE;
+    }
+    if (place < 0 || place >= TOP_TEN_COUNTRIES) {
+        return 0;
+    }
+    return TOP_TEN_COUNTRIES - place;
+}
+
+bool rankingBetter(ScoredCountry first, ScoredCountry second) {
+    if (first.score != second.score) {
+        return first.score > second.score;
+    }
+    return first.id < second.id;
+}
+
+void rankingSort(ScoredCountry *countries, int size) {
+    qsort(countries, size, sizeof(*countries), compareScoredCountries);
+}
+
+void rankingRadixSort(ScoredCountry *countries, int size,
+                      ScoredCountry *buffer) {
+    if (size < RADIX_MIN_SIZE) {
+        rankingSort(countries, size);
+        return;
+    }
+    int counts[KEY_DIGITS][RADIX_SIZE] = {{0}};
+    bool ids_sorted = true;
+    for (int i = 0; i < size; i++) {
+        for (int digit = 0; digit < KEY_DIGITS; digit++) {
+            counts[digit][keyDigit(countries[i], digit)]++;
+        }
+        if (i && countries[i - 1].id > countries[i].id) {
+            ids_sorted = false;
+        }
+    }
+    ScoredCountry *from = countries, *to = buffer, *tmp;
+    /* the passes are stable, so countries already ordered by id need only
+     * the score passes */
+    for (int digit = ids_sorted ? ID_DIGITS : 0; digit < KEY_DIGITS;
+         digit++) {
+        int *positions = counts[digit];
+        if (positions[keyDigit(from[0], digit)] == size) {
+            continue;
+        }
+        int position = 0, count;
+        for (int value = 0; value < RADIX_SIZE; value++) {
+            count = positions[value];
+            positions[value] = position;
+            position += count;
+        }
+        for (int i = 0; i < size; i++) {
+            to[positions[keyDigit(from[i], digit)]++] = from[i];
+        }
+        tmp = from;
+        from = to;
+        to = tmp;
+    }
+    if (from != countries) {
+        memcpy(countries, from, sizeof(*countries) * size);
+    }
+}
+
+int rankingTopK(const ScoredCountry *countries, int size, int k,
+                ScoredCountry *top) {
+    int heap_size = 0;
+    ScoredCountry tmp;
+    for (int i = 0; i < size; i++) {
+        if (heap_size < k) {
+            heapPush(top, heap_size++, countries[i]);
+        } else if (heap_size && rankingBetter(countries[i], top[0])) {
+            top[0] = countries[i];
+            heapSiftDown(top, heap_size, 0);
+        }
+    }
+    for (int last = heap_size - 1; last > 0; last--) {
+        tmp = top[0];
+        top[0] = top[last];
+        top[last] = tmp;
+        heapSiftDown(top, last, 0);
+    }
+    return heap_size;
+}
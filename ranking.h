@@ -0,0 +1,104 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <stdbool.h>
+
+/**
+* Contest ranking utilities, shared by the contest results and the
+* simulation engine.
+*
+* The following functions are available:
+*   rankingContestScore - Returns the weighted contest score of a country.
+*   rankingPlacePoints  - Returns the points given to a place in a top ten.
+*   rankingBetter       - Returns whether a country is ranked before another.
+*   rankingSort         - Sorts countries from the best ranked.
+*   rankingRadixSort    - Sorts countries from the best ranked in linear time.
+*   rankingTopK         - Selects the k best ranked countries.
+*/
+
+/** A country and its contest score */
+typedef struct ScoredCountry_t {
+    int id;
+    long long score;
+} ScoredCountry;
+
+/**
+* rankingContestScore: Calculates the final score of a country in the contest,
+* the audience points are averaged over the voting countries and the judges
+* points over the judges, then both are weighted by audience_percent.
+* The score is kept exact as an integer by multiplying it by countries_num,
+* judge_num and 100, which are the same for all the countries of a contest, so
+* comparing the scores of two countries gives the same order as comparing
+* their real scores.
+*
+* @param audience_points - the points the country got from the audience
+* @param judges_points - the points the country got from the judges
+* @param audience_percent - the weight of the audience points, 1 to 100
+* @param countries_num - the number of countries voting for each country
+* @param judge_num - the number of judges
+* @return
+* 	The weighted score of the country.
+*/
+long long rankingContestScore(int audience_points, int judges_points,
+                              int audience_percent, int countries_num,
+                              int judge_num);
+
+/**
+* rankingPlacePoints: Returns the points a voter gives to the country it
+* placed at a given place of its top ten: 12, 10, 8, 7 ... 1.
+*
+* @param place - the place in the top ten, starting from 0
+* @return
+* 	0 if place is not in the top ten.
+* 	The points of the place otherwise.
+*/
+int rankingPlacePoints(int place);
+
+/**
+* rankingBetter: Decides which of two countries is ranked higher, the higher
+* score wins and on a tie the lower id wins.
+*
+* @param first
+* @param second
+* @return
+* 	true if first is ranked before second, false otherwise.
+*/
+bool rankingBetter(ScoredCountry first, ScoredCountry second);
+
+/**
+* rankingSort: Sorts countries from the best ranked to the worst ranked.
+*
+* @param countries - the countries to sort
+* @param size - the number of countries
+*/
+void rankingSort(ScoredCountry *countries, int size);
+
+/**
+* rankingRadixSort: Sorts countries from the best ranked to the worst ranked,
+* in the same order as rankingSort, with an LSD radix sort over the score and
+* the id. Digits shared by all the countries are skipped, so the small scores
+* of a contest take a few passes, and countries given ordered by id are not
+* sorted by id again. Small arrays are sorted with rankingSort.
+*
+* @param countries - the countries to sort
+* @param size - the number of countries
+* @param buffer - room for size countries, used while sorting
+*/
+void rankingRadixSort(ScoredCountry *countries, int size,
+                      ScoredCountry *buffer);
+
+/**
+* rankingTopK: Selects the k best ranked countries in O(size log k).
+*
+* @param countries - the countries to select from
+* @param size - the number of countries
+* @param k - the number of countries to select
+* @param top - receives the selected countries from the best ranked, must have
+* 		room for k countries
+* @return
+* 	The number of countries written to top, the smaller of k and size.
+*/
+int rankingTopK(const ScoredCountry *countries, int size, int k,
+                ScoredCountry *top);
+
+#endif //RANKING_H
@@ -0,0 +1,524 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "simulation.h"
+#include "ranking.h"
+#include "memstat.h"
+#include <stdbool.h>
+
+#define SIMULATION_THREADS 8
+/* the number of scenario rankings a thread keeps before adding them up */
+#define RANKINGS_BATCH 16
+#define TOP_TEN_COUNTRIES 10
+#define PERCENT 100
+#define NOT_FOUND -1
+
+struct Simulation_t {
+    int states_num;
+    int judge_num;
+    int *ids;
+    int *vote_offsets;
+    int *vote_takers;
+    int *vote_counts;
+    int *audience_points;
+    int *judges_points;
+    int scenarios_num;
+    int *rank_counts;
+};
+
+/**
+ * A vote change of a scenario with its states resolved to their indexes in the
+ * snapshot, order is its position in the scenario.
+ */
+typedef struct ResolvedDelta_t {
+    int giver;
+    int taker;
+    int votes;
+    int order;
+} ResolvedDelta;
+
+/**
+ * The scenarios run by one thread of simulationRun and the memory the thread
+ * works with. rankings holds the states from the best ranked of the last
+ * batched scenarios, they are added to the rank counts of the simulation
+ * under lock once the batch is full, so a thread needs O(states) memory and
+ * not a states x states matrix of its own.
+ */
+typedef struct SimulationTask_t {
+    Simulation simulation;
+    pthread_mutex_t *lock;
+    int audience_percent;
+    const Scenario *scenarios;
+    int first;
+    int last;
+    int *rankings;
+    int batch_size;
+    int batched;
+    int *audience_points;
+    int *votes_row;
+    ResolvedDelta *deltas;
+    ScoredCountry *scored;
+} SimulationTask;
+
+/**
+ * this function finds the index of a state id in the snapshot with a binary
+ * search, the ids are kept in increasing order.
+ * @param simulation
+ * @param state_id
+ * @return
+ * NOT_FOUND if the state is not in the snapshot
+ * the index of the state otherwise
+ */
+static int findState(Simulation simulation, int state_id) {
+    int low = 0, high = simulation->states_num - 1, middle;
+    while (low <= high) {
+        middle = low + (high - low) / 2;
+        if (simulation->ids[middle] == state_id) {
+            return middle;
+        }
+        if (simulation->ids[middle] < state_id) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return NOT_FOUND;
+}
+
+/**
+ * this function finds the top ten of a giver the same way the contest does,
+ * most votes first and on a tie the lower index first, and adds (or removes)
+ * the points of each place to the audience points of the takers.
+ * @param takers - the indexes of the takers, NULL if counts holds the votes of
+ * every index
+ * @param counts - the votes of each taker
+ * @param size - the number of takers
+ * @param audience_points
+ * @param sign - 1 to add the points, -1 to remove them
+ */
+static void addGiverPoints(const int *takers, const int *counts, int size,
+                           int *audience_points, int sign) {
+    int top_takers[TOP_TEN_COUNTRIES], top_counts[TOP_TEN_COUNTRIES];
+    int top_size = 0, taker, place;
+    for (int i = 0; i < size; i++) {
+        if (counts[i] <= 0) {
+            continue;
+        }
+        taker = takers ? takers[i] : i;
+        place = top_size;
+        while (place > 0 && (top_counts[place - 1] < counts[i] ||
+                             (top_counts[place - 1] == counts[i] &&
+                              top_takers[place - 1] > taker))) {
+            place--;
+        }
+        if (place == TOP_TEN_COUNTRIES) {
+            continue;
+        }
+        if (top_size < TOP_TEN_COUNTRIES) {
+            top_size++;
+        }
+        for (int j = top_size - 1; j > place; j--) {
+            top_takers[j] = top_takers[j - 1];
+            top_counts[j] = top_counts[j - 1];
+        }
+        top_takers[place] = taker;
+        top_counts[place] = counts[i];
+    }
+    for (place = 0; place < top_size; place++) {
+        audience_points[top_takers[place]] += sign *
+                                              rankingPlacePoints(place);
+    }
+}
+
+/**
+ * this function is used as a sorting function for qsort, it orders the vote
+ * changes by their giver and the changes of a giver by their order in the
+ * scenario.
+ * @param first
+ * @param second
+ * @return
+ * negative if first comes before second
+ * positive otherwise
+ */
+static int compareResolvedDeltas(const void *first, const void *second) {
+    const ResolvedDelta *first_delta = first, *second_delta = second;
+    if (first_delta->giver != second_delta->giver) {
+        return first_delta->giver < second_delta->giver ? -1 : 1;
+    }
+    return first_delta->order < second_delta->order ? -1 : 1;
+}
+
+/**
+ * this function replaces the points a giver gives in the snapshot by the
+ * points it gives after its vote changes in the scenario, the changes are
+ * applied in their order in the scenario.
+ * @param task
+ * @param giver - the index of the giver
+ * @param deltas - the vote changes of the giver, in their order
+ * @param deltas_num
+ */
+static void applyGiverDeltas(SimulationTask *task, int giver,
+                             const ResolvedDelta *deltas, int deltas_num) {
+    Simulation simulation = task->simulation;
+    int *row = task->votes_row;
+    int begin = simulation->vote_offsets[giver];
+    int end = simulation->vote_offsets[giver + 1];
+    addGiverPoints(simulation->vote_takers + begin,
+                   simulation->vote_counts + begin, end - begin,
+                   task->audience_points, -1);
+    for (int i = begin; i < end; i++) {
+        row[simulation->vote_takers[i]] = simulation->vote_counts[i];
+    }
+    for (int i = 0; i < deltas_num; i++) {
+        row[deltas[i].taker] += deltas[i].votes;
+        if (row[deltas[i].taker] < 0) {
+            row[deltas[i].taker] = 0;
+        }
+    }
+    addGiverPoints(NULL, row, simulation->states_num, task->audience_points,
+                   1);
+    for (int i = begin; i < end; i++) {
+        row[simulation->vote_takers[i]] = 0;
+    }
+    for (int i = 0; i < deltas_num; i++) {
+        row[deltas[i].taker] = 0;
+    }
+}
+
+/**
+ * this function applies the vote changes of a scenario to the audience points
+ * of a task. The states of the changes are resolved once and the changes are
+ * sorted by giver, so the changes of each giver are applied together.
+ * @param task
+ * @param scenario
+ */
+static void applyScenario(SimulationTask *task, const Scenario *scenario) {
+    Simulation simulation = task->simulation;
+    ResolvedDelta *deltas = task->deltas;
+    for (int i = 0; i < scenario->deltas_num; i++) {
+        deltas[i].giver = findState(simulation, scenario->deltas[i].giver);
+        deltas[i].taker = findState(simulation, scenario->deltas[i].taker);
+        deltas[i].votes = scenario->deltas[i].votes;
+        deltas[i].order = i;
+    }
+    qsort(deltas, scenario->deltas_num, sizeof(*deltas),
+          compareResolvedDeltas);
+    int first = 0;
+    for (int i = 1; i <= scenario->deltas_num; i++) {
+        if (i == scenario->deltas_num ||
+            deltas[i].giver != deltas[first].giver) {
+            applyGiverDeltas(task, deltas[first].giver, deltas + first,
+                             i - first);
+            first = i;
+        }
+    }
+}
+
+/**
+ * this function adds the places of the batched scenarios of a task to the
+ * rank counts of the simulation.
+ * @param task
+ */
+static void flushRankings(SimulationTask *task) {
+    Simulation simulation = task->simulation;
+    int states_num = simulation->states_num;
+    const int *ranking;
+    pthread_mutex_lock(task->lock);
+    for (int i = 0; i < task->batched; i++) {
+        ranking = task->rankings + (long) i * states_num;
+        for (int rank = 0; rank < states_num; rank++) {
+            simulation->rank_counts[(long) ranking[rank] * states_num +
+                                    rank]++;
+        }
+    }
+    pthread_mutex_unlock(task->lock);
+    task->batched = 0;
+}
+
+/**
+ * this function is run by the threads of simulationRun, it ranks each
+ * scenario of its task and counts the place of every state.
+ * @param task
+ * @return
+ * the given task
+ */
+static void *runSimulationTask(void *task) {
+    SimulationTask *simulation_task = task;
+    Simulation simulation = simulation_task->simulation;
+    int states_num = simulation->states_num;
+    const Scenario *scenario;
+    int *ranking;
+    for (int i = simulation_task->first; i < simulation_task->last; i++) {
+        scenario = simulation_task->scenarios + i;
+        memcpy(simulation_task->audience_points, simulation->audience_points,
+               sizeof(int) * states_num);
+        applyScenario(simulation_task, scenario);
+        for (int j = 0; j < states_num; j++) {
+            simulation_task->scored[j].id = j;
+            simulation_task->scored[j].score = rankingContestScore
+                    (simulation_task->audience_points[j],
+                     simulation->judges_points[j],
+                     simulation_task->audience_percent, states_num - 1,
+                     simulation->judge_num);
+        }
+        rankingRadixSort(simulation_task->scored, states_num,
+                         simulation_task->scored + states_num);
+        ranking = simulation_task->rankings +
+                  (long) simulation_task->batched++ * states_num;
+        for (int rank = 0; rank < states_num; rank++) {
+            ranking[rank] = simulation_task->scored[rank].id;
+        }
+        if (simulation_task->batched == simulation_task->batch_size) {
+            flushRankings(simulation_task);
+        }
+    }
+    if (simulation_task->batched) {
+        flushRankings(simulation_task);
+    }
+    return task;
+}
+
+/**
+ * this function frees the memory of a simulation task.
+ * @param task
+ */
+static void taskClear(SimulationTask *task) {
+    memstatFree(task->rankings);
+    memstatFree(task->audience_points);
+    memstatFree(task->votes_row);
+    memstatFree(task->deltas);
+    memstatFree(task->scored);
+}
+
+/**
+ * this function allocates the memory a simulation task works with, the range
+ * of scenarios of the task must be set.
+ * @param task
+ * @param states_num
+ * @return
+ * SIMULATION_OUT_OF_MEMORY if an allocation failed
+ * SIMULATION_SUCCESS otherwise
+ */
+static SimulationResult taskInit(SimulationTask *task, int states_num) {
+    task->batch_size = task->last - task->first < RANKINGS_BATCH ?
+                       task->last - task->first : RANKINGS_BATCH;
+    task->batched = 0;
+    task->rankings = memstatMalloc(MEMSTAT_SIMULATION, sizeof(int) *
+                                   task->batch_size * states_num);
+    task->audience_points = memstatMalloc(MEMSTAT_SIMULATION,
+                                          sizeof(int) * states_num);
+    task->votes_row = memstatCalloc(MEMSTAT_SIMULATION,
+                                    states_num, sizeof(int));
+    int deltas_num = 0;
+    for (int i = task->first; i < task->last; i++) {
+        if (task->scenarios[i].deltas_num > deltas_num) {
+            deltas_num = task->scenarios[i].deltas_num;
+        }
+    }
+    task->deltas = memstatMalloc(MEMSTAT_SIMULATION,
+                                 sizeof(ResolvedDelta) * (deltas_num + 1));
+    task->scored = memstatMalloc(MEMSTAT_SIMULATION,
+                                 sizeof(ScoredCountry) * 2 * states_num);
+    if (!task->rankings || !task->audience_points || !task->votes_row ||
+        !task->deltas || !task->scored) {
+        taskClear(task);
+        return SIMULATION_OUT_OF_MEMORY;
+    }
+    return SIMULATION_SUCCESS;
+}
+
+/**
+ * this function checks the vote changes of all the scenarios before any of
+ * them is run.
+ * @param simulation
+ * @param scenarios
+ * @param scenarios_num
+ * @return
+ * SIMULATION_NULL_ARGUMENT if a scenario has no vote changes array
+ * SIMULATION_INVALID_ARGUMENT if a state gives votes to itself
+ * SIMULATION_STATE_NOT_EXIST if a vote change refers to an unknown state
+ * SIMULATION_SUCCESS otherwise
+ */
+static SimulationResult checkScenarios(Simulation simulation,
+                                       const Scenario *scenarios,
+                                       int scenarios_num) {
+    const VoteDelta *delta;
+    for (int i = 0; i < scenarios_num; i++) {
+        if (!scenarios[i].deltas && scenarios[i].deltas_num > 0) {
+            return SIMULATION_NULL_ARGUMENT;
+        }
+        for (int j = 0; j < scenarios[i].deltas_num; j++) {
+            delta = scenarios[i].deltas + j;
+            if (findState(simulation, delta->giver) == NOT_FOUND ||
+                findState(simulation, delta->taker) == NOT_FOUND) {
+                return SIMULATION_STATE_NOT_EXIST;
+            }
+            if (delta->giver == delta->taker) {
+                return SIMULATION_INVALID_ARGUMENT;
+            }
+        }
+    }
+    return SIMULATION_SUCCESS;
+}
+
+Simulation simulationCreate(int states_num, const int *ids,
+                            const int *vote_offsets, const int *vote_takers,
+                            const int *vote_counts, const int *judges_points,
+                            int judge_num) {
+    if (states_num < 0 || !vote_offsets || (states_num && (!ids ||
+        !judges_points)) || (vote_offsets[states_num] &&
+        (!vote_takers || !vote_counts))) {
+        return NULL;
+    }
+    Simulation simulation = memstatMalloc(MEMSTAT_SIMULATION,
+                                          sizeof(*simulation));
+    if (!simulation) {
+        return NULL;
+    }
+    int votes_num = vote_offsets[states_num];
+    simulation->states_num = states_num;
+    simulation->judge_num = judge_num;
+    simulation->scenarios_num = 0;
+    simulation->ids = memstatMalloc(MEMSTAT_SIMULATION,
+                                    sizeof(int) * (states_num + 1));
+    simulation->vote_offsets = memstatMalloc(MEMSTAT_SIMULATION,
+                                             sizeof(int) * (states_num + 1));
+    simulation->vote_takers = memstatMalloc(MEMSTAT_SIMULATION,
+                                            sizeof(int) * (votes_num + 1));
+    simulation->vote_counts = memstatMalloc(MEMSTAT_SIMULATION,
+                                            sizeof(int) * (votes_num + 1));
+    simulation->audience_points = memstatCalloc(MEMSTAT_SIMULATION,
+                                                states_num + 1, sizeof(int));
+    simulation->judges_points = memstatMalloc(MEMSTAT_SIMULATION,
+                                              sizeof(int) * (states_num + 1));
+    simulation->rank_counts =
+            memstatCalloc(MEMSTAT_SIMULATION,
+                          (size_t) states_num * states_num + 1, sizeof(int));
+    if (!simulation->ids || !simulation->vote_offsets ||
+        !simulation->vote_takers || !simulation->vote_counts ||
+        !simulation->audience_points || !simulation->judges_points ||
+        !simulation->rank_counts) {
+        simulationDestroy(simulation);
+        return NULL;
+    }
+    /* the arrays of states and votes may be NULL when they are empty */
+    if (states_num) {
+        memcpy(simulation->ids, ids, sizeof(int) * states_num);
+        memcpy(simulation->judges_points, judges_points,
+               sizeof(int) * states_num);
+    }
+    memcpy(simulation->vote_offsets, vote_offsets,
+           sizeof(int) * (states_num + 1));
+    if (votes_num) {
+        memcpy(simulation->vote_counts, vote_counts, sizeof(int) * votes_num);
+    }
+    for (int i = 0; i < votes_num; i++) {
+        simulation->vote_takers[i] = findState(simulation, vote_takers[i]);
+        if (simulation->vote_takers[i] == NOT_FOUND) {
+            simulationDestroy(simulation);
+            return NULL;
+        }
+    }
+    for (int i = 0; i < states_num; i++) {
+        addGiverPoints(simulation->vote_takers + vote_offsets[i],
+                       simulation->vote_counts + vote_offsets[i],
+                       vote_offsets[i + 1] - vote_offsets[i],
+                       simulation->audience_points, 1);
+    }
+    return simulation;
+}
+
+void simulationDestroy(Simulation simulation) {
+    if (!simulation) {
+        return;
+    }
+    memstatFree(simulation->ids);
+    memstatFree(simulation->vote_offsets);
+    memstatFree(simulation->vote_takers);
+    memstatFree(simulation->vote_counts);
+    memstatFree(simulation->audience_points);
+    memstatFree(simulation->judges_points);
+    memstatFree(simulation->rank_counts);
+    memstatFree(simulation);
+}
+
+SimulationResult simulationRun(Simulation simulation, int audience_percent,
+                               const Scenario *scenarios, int scenarios_num) {
+    if (!simulation || !scenarios) {
+        return SIMULATION_NULL_ARGUMENT;
+    }
+    if (audience_percent < 1 || audience_percent > PERCENT ||
+        scenarios_num < 1) {
+        return SIMULATION_INVALID_ARGUMENT;
+    }
+    SimulationResult result = checkScenarios(simulation, scenarios,
+                                             scenarios_num);
+    if (result != SIMULATION_SUCCESS || !simulation->states_num) {
+        return result;
+    }
+    int threads_num = scenarios_num < SIMULATION_THREADS ? scenarios_num :
+                      SIMULATION_THREADS;
+    SimulationTask tasks[SIMULATION_THREADS];
+    pthread_t threads[SIMULATION_THREADS];
+    bool started[SIMULATION_THREADS];
+    pthread_mutex_t lock;
+    /* all the memory is allocated before any scenario is run, so the rank
+     * counts are left unchanged if an allocation fails */
+    for (int i = 0; i < threads_num; i++) {
+        tasks[i].simulation = simulation;
+        tasks[i].lock = &lock;
+        tasks[i].audience_percent = audience_percent;
+        tasks[i].scenarios = scenarios;
+        tasks[i].first = (int) ((long) scenarios_num * i / threads_num);
+        tasks[i].last = (int) ((long) scenarios_num * (i + 1) / threads_num);
+        if (taskInit(tasks + i, simulation->states_num) != SIMULATION_SUCCESS) {
+            for (int j = 0; j < i; j++) {
+                taskClear(tasks + j);
+            }
+            return SIMULATION_OUT_OF_MEMORY;
+        }
+    }
+    pthread_mutex_init(&lock, NULL);
+    /* the threads are created for each call and none are kept between calls,
+     * the same as eurovisionRunContestSweep: a simulation holds no threads
+     * while it is not running, and creating a few threads is small next to
+     * ranking their scenarios. The first range is run by the calling thread
+     * itself */
+    for (int i = 0; i < threads_num; i++) {
+        started[i] = i > 0 && !pthread_create(threads + i, NULL,
+                                              runSimulationTask, tasks + i);
+    }
+    for (int i = 0; i < threads_num; i++) {
+        if (!started[i]) {
+            runSimulationTask(tasks + i);
+        }
+    }
+    for (int i = 0; i < threads_num; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        taskClear(tasks + i);
+    }
+    pthread_mutex_destroy(&lock);
+    simulation->scenarios_num += scenarios_num;
+    return SIMULATION_SUCCESS;
+}
+
+int simulationGetScenariosNum(Simulation simulation) {
+    if (!simulation) {
+        return -1;
+    }
+    return simulation->scenarios_num;
+}
+
+int simulationGetRankCount(Simulation simulation, int state_id, int rank) {
+    if (!simulation || rank < 0 || rank >= simulation->states_num) {
+        return -1;
+    }
+    int index = findState(simulation, state_id);
+    if (index == NOT_FOUND) {
+        return -1;
+    }
+    return simulation->rank_counts[(long) index * simulation->states_num +
+                                   rank];
+}
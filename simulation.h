@@ -0,0 +1,127 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+/**
+* What-if simulation of contest votes.
+*
+* A simulation holds a flat snapshot of the votes and judges points of a
+* contest. Each scenario is a short list of vote changes applied on top of the
+* snapshot, the snapshot itself is never copied or changed. Running scenarios
+* adds up, for each state, how many scenarios ranked it at each place.
+*
+* The following functions are available:
+*   simulationCreate          - Creates a simulation from a contest snapshot.
+*   simulationDestroy         - Deletes a simulation and frees all resources.
+*   simulationRun             - Runs scenarios and adds up their rankings.
+*   simulationGetScenariosNum - Returns the number of scenarios run so far.
+*   simulationGetRankCount    - Returns how many scenarios ranked a state at a
+*                               given place.
+*/
+
+/** Type for defining the simulation */
+typedef struct Simulation_t *Simulation;
+
+/** Type used for returning error codes from simulation functions */
+typedef enum SimulationResult_t {
+    SIMULATION_SUCCESS,
+    SIMULATION_OUT_OF_MEMORY,
+    SIMULATION_NULL_ARGUMENT,
+    SIMULATION_INVALID_ARGUMENT,
+    SIMULATION_STATE_NOT_EXIST
+} SimulationResult;
+
+/**
+* A change of the votes a giver state gives a taker state. A positive votes
+* value adds votes and a negative one removes votes, the votes never drop
+* below zero, the same as adding and removing single votes in the contest.
+*/
+typedef struct VoteDelta_t {
+    int giver;
+    int taker;
+    int votes;
+} VoteDelta;
+
+/** A scenario, the vote changes are applied in order */
+typedef struct Scenario_t {
+    const VoteDelta *deltas;
+    int deltas_num;
+} Scenario;
+
+/**
+* simulationCreate: Allocates a new simulation from a contest snapshot.
+* The votes are given per giver state: the votes of the giver at index i are
+* at indexes vote_offsets[i] to vote_offsets[i + 1] - 1 of vote_takers and
+* vote_counts. All the arrays are copied.
+*
+* @param states_num - the number of states
+* @param ids - the ids of the states in increasing order
+* @param vote_offsets - states_num + 1 offsets into the votes arrays
+* @param vote_takers - the ids of the states receiving the votes
+* @param vote_counts - the number of votes, all positive
+* @param judges_points - the points each state got from the judges
+* @param judge_num - the number of judges
+* @return
+* 	NULL - if one of the arrays is NULL, a taker is not one of the states or
+* 	an allocation failed.
+* 	A new Simulation in case of success.
+*/
+Simulation simulationCreate(int states_num, const int *ids,
+                            const int *vote_offsets, const int *vote_takers,
+                            const int *vote_counts, const int *judges_points,
+                            int judge_num);
+
+/**
+* simulationDestroy: Deallocates an existing simulation.
+*
+* @param simulation - Target simulation to be deallocated. If simulation is
+* 		NULL nothing will be done
+*/
+void simulationDestroy(Simulation simulation);
+
+/**
+* simulationRun: Ranks every scenario the same way the contest does and adds
+* the place of every state to the rank counts of the simulation. The
+* scenarios are split between up to 8 threads created for the call, one of
+* them the calling thread, and each thread needs memory for a few rankings
+* beside the rank counts.
+*
+* @param simulation
+* @param audience_percent - the weight of the audience points, 1 to 100
+* @param scenarios
+* @param scenarios_num
+* @return
+* 	SIMULATION_NULL_ARGUMENT if a NULL was sent
+* 	SIMULATION_INVALID_ARGUMENT if audience_percent or scenarios_num is
+* 	illegal, or a state gives votes to itself
+* 	SIMULATION_STATE_NOT_EXIST if a vote change refers to an unknown state
+* 	SIMULATION_OUT_OF_MEMORY if an allocation failed, the rank counts are
+* 	left unchanged
+* 	SIMULATION_SUCCESS otherwise
+*/
+SimulationResult simulationRun(Simulation simulation, int audience_percent,
+                               const Scenario *scenarios, int scenarios_num);
+
+/**
+* simulationGetScenariosNum: Returns the number of scenarios run so far.
+*
+* @param simulation
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of scenarios run.
+*/
+int simulationGetScenariosNum(Simulation simulation);
+
+/**
+* simulationGetRankCount: Returns in how many of the scenarios run so far the
+* given state was ranked at the given place.
+*
+* @param simulation
+* @param state_id
+* @param rank - the place, 0 for the winner
+* @return
+* 	-1 if a NULL pointer was sent, the state is unknown or rank is illegal.
+* 	Otherwise the number of scenarios.
+*/
+int simulationGetRankCount(Simulation simulation, int state_id, int rank);
+
+#endif //SIMULATION_H
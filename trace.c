@@ -0,0 +1,147 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <time.h>
+#include "trace.h"
+
+#define NANOS_PER_SECOND 1000000000L
+#define NANOS_PER_MICRO 1000.0
+
+/** One timed call of a phase */
+typedef struct TraceEvent_t
+{
+    TracePhase phase;
+    int thread;
+    long start;
+    long duration;
+} TraceEvent;
+
+static TraceCounters counters[TRACE_PHASES];
+static TraceEvent* events=NULL;
+static long events_capacity=0;
+static long events_next=0;
+static long origin=0;
+static int threads_num=0;
+/* the id of the calling thread in the trace, 0 until it records an event */
+static __thread int thread_id=0;
+
+static const char* phase_names[TRACE_PHASES]={
+        "eurovisionRunContest",
+        "eurovisionRunAudienceFavorite",
+        "eurovisionRunGetFriendlyStates",
+        "eurovisionRunContestSweep",
+        "syncVotes",
+        "fillAudienceScore",
+        "fillJudgeScore",
+        "ranking",
+        "listBuild",
+        "friendlyPairs"};
+
+long traceNow()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC,&time);
+    return time.tv_sec*NANOS_PER_SECOND+time.tv_nsec;
+}
+
+/**
+* this function keeps a timed call as an event, if recording is on and there
+* is room for it.
+*/
+static void recordEvent(TracePhase phase, long start, long duration)
+{
+    if(!events)
+    {
+        return;
+    }
+    long index=__atomic_fetch_add(&events_next,1,__ATOMIC_RELAXED);
+    if(index>=events_capacity)
+    {
+        return;
+    }
+    if(!thread_id)
+    {
+        thread_id=__atomic_add_fetch(&threads_num,1,__ATOMIC_RELAXED);
+    }
+    events[index].phase=phase;
+    events[index].thread=thread_id;
+    events[index].start=start;
+    events[index].duration=duration;
+}
+
+void traceEnd(TracePhase phase, long start)
+{
+    long duration=traceNow()-start;
+    TraceCounters* counter=counters+phase;
+    __atomic_add_fetch(&counter->calls,1,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&counter->total_ns,duration,__ATOMIC_RELAXED);
+    long max=__atomic_load_n(&counter->max_ns,__ATOMIC_RELAXED);
+    while(duration>max && !__atomic_compare_exchange_n(&counter->max_ns,&max,
+                                                       duration,true,
+                                                       __ATOMIC_RELAXED,
+                                                       __ATOMIC_RELAXED))
+    {
+    }
+    recordEvent(phase,start,duration);
+}
+
+TraceCounters traceGet(TracePhase phase)
+{
+    TraceCounters result;
+    result.calls=__atomic_load_n(&counters[phase].calls,__ATOMIC_RELAXED);
+    result.total_ns=__atomic_load_n(&counters[phase].total_ns,
+                                    __ATOMIC_RELAXED);
+    result.max_ns=__atomic_load_n(&counters[phase].max_ns,__ATOMIC_RELAXED);
+    return result;
+}
+
+const char* tracePhaseName(TracePhase phase)
+{
+    return phase_names[phase];
+}
+
+void traceReset()
+{
+    for(int i=0; i<TRACE_PHASES; i++)
+    {
+        counters[i].calls=0;
+        counters[i].total_ns=0;
+        counters[i].max_ns=0;
+    }
+    free(events);
+    events=NULL;
+    events_capacity=0;
+    events_next=0;
+}
+
+bool traceStartRecording(long capacity)
+{
+    TraceEvent* new_events=malloc(sizeof(TraceEvent)*(capacity>0 ?
+                                                      capacity : 1));
+    if(!new_events)
+    {
+        return false;
+    }
+    free(events);
+    events=new_events;
+    events_capacity=capacity;
+    events_next=0;
+    origin=traceNow();
+    return true;
+}
+
+bool traceWriteChrome(FILE* file)
+{
+    long events_num=events_next<events_capacity ? events_next :
+                    events_capacity;
+    bool success=fprintf(file,"{\"traceEvents\":[")>=0;
+    for(long i=0; i<events_num && success; i++)
+    {
+        success=fprintf(file,"%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                             "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        i ? "," : "",phase_names[events[i].phase],
+                        events[i].thread,
+                        (events[i].start-origin)/NANOS_PER_MICRO,
+                        events[i].duration/NANOS_PER_MICRO)>=0;
+    }
+    return success && fprintf(file,"\n]}\n")>=0;
+}
@@ -0,0 +1,103 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/**
+* Phase Tracing
+*
+* Times the phases of the eurovision result functions. Each phase counts its
+* calls and the total and longest time spent in it, and while recording is on
+* every timed call is also kept as an event that can be written as a Chrome
+* trace (chrome://tracing or ui.perfetto.dev).
+* The phases are timed only when the program is compiled with
+* -DEUROVISION_TRACE, otherwise TRACE_BEGIN and TRACE_END compile to nothing
+* and the counters stay zero. The counters may be updated by several threads
+* at once.
+*
+* The following functions are available:
+*   traceNow		- Returns the time of a monotonic clock in nanoseconds
+*   traceEnd		- Counts a call of a phase that started at a given time
+*   traceGet		- Returns the counters of a phase
+*   tracePhaseName	- Returns the name of a phase
+*   traceReset		- Zeroes the counters and stops recording
+*   traceStartRecording	- Starts keeping the timed calls as events
+*   traceWriteChrome	- Writes the recorded events as a Chrome trace
+*/
+
+/** The phases that are timed */
+typedef enum TracePhase_t {
+    TRACE_RUN_CONTEST,
+    TRACE_RUN_AUDIENCE_FAVORITE,
+    TRACE_RUN_FRIENDLY_STATES,
+    TRACE_RUN_CONTEST_SWEEP,
+    TRACE_SYNC_VOTES,
+    TRACE_AUDIENCE_SCORE,
+    TRACE_JUDGE_SCORE,
+    TRACE_RANKING,
+    TRACE_LIST_BUILD,
+    TRACE_FRIENDLY_PAIRS,
+    TRACE_PHASES
+} TracePhase;
+
+/** The counters of one phase */
+typedef struct TraceCounters_t {
+    long calls;
+    long total_ns;
+    long max_ns;
+} TraceCounters;
+
+#ifdef EUROVISION_TRACE
+#define TRACE_BEGIN(span) long span = traceNow()
+#define TRACE_END(span, phase) traceEnd((phase), (span))
+#else
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, phase) ((void)0)
+#endif
+
+/**
+* traceNow: Returns the time of a monotonic clock in nanoseconds.
+*/
+long traceNow();
+
+/**
+* traceEnd: Counts a call of a phase that started at the given time of
+* traceNow, and records it as an event while recording is on.
+*/
+void traceEnd(TracePhase phase, long start);
+
+/**
+* traceGet: Returns the counters of a phase.
+*/
+TraceCounters traceGet(TracePhase phase);
+
+/**
+* tracePhaseName: Returns the name of a phase, as used in the Chrome trace.
+*/
+const char* tracePhaseName(TracePhase phase);
+
+/**
+* traceReset: Zeroes the counters of all the phases, stops recording and drops
+* the recorded events. Must not be called while phases are timed.
+*/
+void traceReset();
+
+/**
+* traceStartRecording: Drops the recorded events and keeps the next capacity
+* timed calls as events, later calls are counted but not recorded. Must not be
+* called while phases are timed.
+* @return
+* 	false if an allocation failed, true otherwise.
+*/
+bool traceStartRecording(long capacity);
+
+/**
+* traceWriteChrome: Writes the recorded events to a file in the Chrome trace
+* event format. Must not be called while phases are timed.
+* @return
+* 	false if writing failed, true otherwise.
+*/
+bool traceWriteChrome(FILE* file);
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,210 @@
+#ifndef TYPED_MAP_H_
+#define TYPED_MAP_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "map.h"
+#include "memstat.h"
+
+/**
+* Type Specialized Map Generator
+*
+* Generates an ordered map for a given key and value type. Keys and values
+* are stored by value in two sorted arrays, keys are compared with the < and
+* == operators directly instead of through a function pointer, so the key
+* type must be a number. Values which own memory are not freed by the map,
+* the user frees them before removing or destroying. The arrays are counted
+* as MEMSTAT_MAP memory, see memstat.h.
+*
+* DEFINE_MAP(IntToInt, int, int) defines the type IntToInt and the following
+* static inline functions:
+*   IntToIntCreate	- Creates a new empty map
+*   IntToIntDestroy	- Deletes an existing map and frees its arrays
+*   IntToIntGetSize	- Returns the size of a given map
+*   IntToIntContains	- Returns weather or not a key exists inside the map
+*   IntToIntGet		- Returns a pointer to the value paired to a key
+*   IntToIntPut		- Gives a specific key a given value, appending to
+*   				  the end of the map in amortized O(1)
+*   IntToIntRemove	- Removes the pair of a given key
+*   IntToIntClear	- Removes all pairs from the map
+*   IntToIntKeyAt	- Returns the key at a given index in increasing order
+*   IntToIntValueAt	- Returns a pointer to the value at a given index
+*
+* A pointer returned by Get or ValueAt is valid until the map next changes.
+*
+* A header may use DECLARE_MAP(Name) to declare the map type without its
+* element types, and the source file then uses DEFINE_MAP_FUNCTIONS(Name,
+* K, V) to complete it.
+*/
+
+#define TYPED_MAP_FIRST_CAPACITY 4
+
+#define DECLARE_MAP(Name) \
+typedef struct Name##_t *Name;
+
+#define DEFINE_MAP(Name, K, V) \
+DECLARE_MAP(Name) \
+DEFINE_MAP_FUNCTIONS(Name, K, V)
+
+#define DEFINE_MAP_FUNCTIONS(Name, K, V) \
+struct Name##_t \
+{ \
+    K *keys; \
+    V *values; \
+    int size; \
+    int capacity; \
+}; \
+\
+static inline Name Name##Create() \
+{ \
+    Name map=memstatMalloc(MEMSTAT_MAP,sizeof(*map)); \
+    if(!map) \
+    { \
+        return NULL; \
+    } \
+    map->keys=NULL; \
+    map->values=NULL; \
+    map->size=0; \
+    map->capacity=0; \
+    return map; \
+} \
+\
+static inline void Name##Destroy(Name map) \
+{ \
+    if(!map) \
+    { \
+        return; \
+    } \
+    memstatFree(map->keys); \
+    memstatFree(map->values); \
+    memstatFree(map); \
+} \
+\
+static inline int Name##GetSize(Name map) \
+{ \
+    return map ? map->size : -1; \
+} \
+\
+/* returns the index of the first key which is not smaller than key */ \
+static inline int Name##LowerBound(Name map, K key) \
+{ \
+    int low=0, high=map->size; \
+    if(high && map->keys[high-1]<key) \
+    { \
+        return high; \
+    } \
+    while(low<high) \
+    { \
+        int middle=low+(high-low)/2; \
+        if(map->keys[middle]<key) \
+        { \
+            low=middle+1; \
+        } \
+        else \
+        { \
+            high=middle; \
+        } \
+    } \
+    return low; \
+} \
+\
+static inline V* Name##Get(Name map, K key) \
+{ \
+    if(!map) \
+    { \
+        return NULL; \
+    } \
+    int index=Name##LowerBound(map,key); \
+    if(index==map->size || !(map->keys[index]==key)) \
+    { \
+        return NULL; \
+    } \
+    return map->values+index; \
+} \
+\
+static inline bool Name##Contains(Name map, K key) \
+{ \
+    return Name##Get(map,key)!=NULL; \
+} \
+\
+static inline MapResult Name##Put(Name map, K key, V value) \
+{ \
+    if(!map) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    int index=Name##LowerBound(map,key); \
+    if(index<map->size && map->keys[index]==key) \
+    { \
+        map->values[index]=value; \
+        return MAP_SUCCESS; \
+    } \
+    if(map->size==map->capacity) \
+    { \
+        int capacity=map->capacity ? map->capacity*2 : \
+                                     TYPED_MAP_FIRST_CAPACITY; \
+        K *keys=memstatRealloc(MEMSTAT_MAP,map->keys,sizeof(K)*capacity); \
+        if(!keys) \
+        { \
+            return MAP_OUT_OF_MEMORY; \
+        } \
+        map->keys=keys; \
+        V *values=memstatRealloc(MEMSTAT_MAP,map->values,sizeof(V)*capacity); \
+        if(!values) \
+        { \
+            return MAP_OUT_OF_MEMORY; \
+        } \
+        map->values=values; \
+        map->capacity=capacity; \
+    } \
+    memmove(map->keys+index+1,map->keys+index, \
+            sizeof(K)*(map->size-index)); \
+    memmove(map->values+index+1,map->values+index, \
+            sizeof(V)*(map->size-index)); \
+    map->keys[index]=key; \
+    map->values[index]=value; \
+    (map->size)++; \
+    return MAP_SUCCESS; \
+} \
+\
+static inline MapResult Name##Remove(Name map, K key) \
+{ \
+    if(!map) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    int index=Name##LowerBound(map,key); \
+    if(index==map->size || !(map->keys[index]==key)) \
+    { \
+        return MAP_ITEM_DOES_NOT_EXIST; \
+    } \
+    (map->size)--; \
+    memmove(map->keys+index,map->keys+index+1, \
+            sizeof(K)*(map->size-index)); \
+    memmove(map->values+index,map->values+index+1, \
+            sizeof(V)*(map->size-index)); \
+    return MAP_SUCCESS; \
+} \
+\
+static inline MapResult Name##Clear(Name map) \
+{ \
+    if(!map) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    map->size=0; \
+    return MAP_SUCCESS; \
+} \
+\
+static inline K Name##KeyAt(Name map, int index) \
+{ \
+    return map->keys[index]; \
+} \
+\
+static inline V* Name##ValueAt(Name map, int index) \
+{ \
+    return map->values+index; \
+}
+
+#endif /* TYPED_MAP_H_ */
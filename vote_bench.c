@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "eurovision.h"
+
+#define DEFAULT_STATES 200
+#define DEFAULT_VOTES 4000000
+#define MAX_THREADS 64
+/* one vote in REMOVE_EVERY is removed instead of added */
+#define REMOVE_EVERY 4
+#define MODES 3
+
+/**
+* The votes one benchmark thread sends, from random givers to random takers,
+* either directly or through a vote writer of its own.
+*/
+typedef struct VoteTask_t {
+    Eurovision eurovision;
+    bool buffered;
+    int states;
+    int votes;
+    unsigned int seed;
+    int failures;
+} VoteTask;
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC,&time);
+    return time.tv_sec+time.tv_nsec/1e9;
+}
+
+/**
+* this function returns the next number of a xorshift random sequence.
+* @param state - the state of the sequence, updated.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+    unsigned int x=*state;
+    x^=x<<13;
+    x^=x>>17;
+    x^=x<<5;
+    *state=x;
+    return x;
+}
+
+static void *runVotes(void *argument)
+{
+    VoteTask *task=argument;
+    EurovisionVoteWriter writer=NULL;
+    if(task->buffered)
+    {
+        writer=eurovisionCreateVoteWriter(task->eurovision);
+        if(writer==NULL)
+        {
+            task->failures++;
+            return NULL;
+        }
+    }
+    for(int i=0; i<task->votes; i++)
+    {
+        int giver=nextRandom(&task->seed)%task->states;
+        int taker=(giver+1+nextRandom(&task->seed)%(task->states-1))%
+                  task->states;
+        EurovisionResult result;
+        if(writer)
+        {
+            result=i%REMOVE_EVERY==0 ?
+                    eurovisionWriterRemoveVote(writer,giver,taker) :
+                    eurovisionWriterAddVote(writer,giver,taker);
+        }
+        else
+        {
+            result=i%REMOVE_EVERY==0 ?
+                    eurovisionRemoveVote(task->eurovision,giver,taker) :
+                    eurovisionAddVote(task->eurovision,giver,taker);
+        }
+        if(result!=EUROVISION_SUCCESS)
+        {
+            task->failures++;
+        }
+    }
+    eurovisionDestroyVoteWriter(writer);
+    return NULL;
+}
+
+/**
+* this function sends votes to a new contest from the given number of
+* threads at once and returns the time it took in seconds, or a negative
+* number on failure. buffered votes are merged into the contest before the
+* time is taken.
+* @param states - number of states in the contest.
+* @param votes - number of votes all the threads send together.
+* @param threads_num - number of threads.
+* @param buffered - whether the threads send through vote writers.
+* @param table - whether the contest uses a vote table.
+*/
+static double benchVotes(int states, int votes, int threads_num,
+                         bool buffered, bool table)
+{
+    Eurovision eurovision=eurovisionCreate();
+    if(eurovision==NULL)
+    {
+        return -1;
+    }
+    for(int i=0; i<states; i++)
+    {
+        if(eurovisionAddState(eurovision,i,"state","song")!=
+           EUROVISION_SUCCESS)
+        {
+            eurovisionDestroy(eurovision);
+            return -1;
+        }
+    }
+    if(table && eurovisionUseVoteTable(eurovision)!=EUROVISION_SUCCESS)
+    {
+        return -1;
+    }
+    pthread_t threads[MAX_THREADS];
+    VoteTask tasks[MAX_THREADS];
+    double start=now();
+    int started=0;
+    for(int i=0; i<threads_num; i++)
+    {
+        tasks[i].eurovision=eurovision;
+        tasks[i].buffered=buffered;
+        tasks[i].states=states;
+        tasks[i].votes=votes/threads_num;
+        tasks[i].seed=2463534242u+i;
+        tasks[i].failures=0;
+        if(pthread_create(threads+i,NULL,runVotes,tasks+i)!=0)
+        {
+            break;
+        }
+        started++;
+    }
+    int failures=started<threads_num;
+    for(int i=0; i<started; i++)
+    {
+        pthread_join(threads[i],NULL);
+        failures+=tasks[i].failures;
+    }
+    if(eurovisionMergeVotes(eurovision)!=EUROVISION_SUCCESS)
+    {
+        return -1;
+    }
+    double time=now()-start;
+    eurovisionDestroy(eurovision);
+    return failures ? -1 : time;
+}
+
+int main(int argc, char** argv)
+{
+    int states=argc>1 ? atoi(argv[1]) : DEFAULT_STATES;
+    int votes=argc>2 ? atoi(argv[2]) : DEFAULT_VOTES;
+    if(states<2 || votes<MAX_THREADS)
+    {
+        fprintf(stderr,"usage: %s [states] [votes]\n",argv[0]);
+        return 1;
+    }
+    const int threads_nums[]={1,4,16,64};
+    printf("states: %d votes: %d\n",states,votes);
+    const char *modes[MODES]={"eurovisionAddVote","vote writers","vote table"};
+    for(int mode=0; mode<MODES; mode++)
+    {
+        printf("%s\n",modes[mode]);
+        for(int i=0; i<(int)(sizeof(threads_nums)/sizeof(*threads_nums)); i++)
+        {
+            double time=benchVotes(states,votes,threads_nums[i],mode==1,
+                                   mode==2);
+            if(time<0)
+            {
+                fprintf(stderr,"benchmark failed\n");
+                return 1;
+            }
+            printf("%2d threads %9.3f ms %12.0f votes/s\n",threads_nums[i],
+                   time*1e3,votes/time);
+        }
+    }
+    return 0;
+}